@@ -0,0 +1,165 @@
+// Checks the exporter of the companion and measures it on a large history:
+// the time to export thousands of synthetic workouts as CSV and TCX, and the
+// peak heap while doing so, above what the history itself takes.
+//
+//   node bench/export_bench.js [workouts]
+//
+// Exits with 1 if a check fails. Run node with --expose-gc for steadier
+// memory numbers.
+
+var exporter = require('../src/js/export.js');
+
+var failures = 0;
+
+function check(condition, message) {
+    if (!condition) {
+        console.log('  FAIL ' + message);
+        ++failures;
+    }
+}
+
+//
+// encoding, as LaneSplits_encode() of src/lane_splits.c
+
+function writeVarint(bytes, value) {
+    do {
+        bytes.push((value & 0x7f) | (value >= 0x80 ? 0x80 : 0));
+        value = Math.floor(value / 128);
+    } while (value);
+}
+
+function encodeSplits(records, target) {
+    var bytes = [2];
+    writeVarint(bytes, target);
+    records.forEach(function(record) {
+        if (record.pauseTime > 0) {
+            bytes.push(0x81);
+            writeVarint(bytes, record.pauseTime);
+        }
+        if (record.restart) bytes.push(0x82);
+        if (record.laneSpan !== 1) bytes.push(0x83, record.laneSpan);
+
+        var delta = record.splitTime - target * record.laneSpan;
+        if (delta >= -124 && delta <= 127) {
+            bytes.push(delta & 0xff);
+        } else {
+            bytes.push(0x80);
+            writeVarint(bytes, record.splitTime);
+        }
+    });
+    return bytes;
+}
+
+function lane(splitTime, options) {
+    options = options || {};
+    return { splitTime: splitTime, pauseTime: options.pauseTime || 0, laneSpan: options.laneSpan || 1,
+             restart: !!options.restart };
+}
+
+function workout(id, laneCount) {
+    var startTime = 1700000000 + id * 86400;
+    return { id: id, startTime: startTime, endTime: startTime + laneCount * 36 + 300, pauseTime: 300,
+             laneCount: laneCount, lengthOfLane: 25 };
+}
+
+function exportToString(format, workouts, splits) {
+    var pieces = [];
+    exporter[format](workouts, splits, function(piece) { pieces.push(piece); });
+    return pieces.join('');
+}
+
+//
+// checks
+
+function testRestarts() {
+    var workouts = { 1: workout(1, 3) };
+    var splits = { 1: encodeSplits([lane(360), lane(80, { restart: true }), lane(350), lane(720, { laneSpan: 2 })], 360) };
+
+    var rows = exportToString('exportCsv', workouts, splits).trim().split('\n').slice(1);
+    var lanes = rows.map(function(row) { return row.split(',')[6]; });
+    check(lanes.join(' ') === '1 2 2 4', 'restart numbering: lanes ' + lanes.join(' '));
+
+    var tcx = exportToString('exportTcx', workouts, splits);
+    check(tcx.split('<Lap ').length - 1 === 3, 'restart in TCX: ' + (tcx.split('<Lap ').length - 1) + ' laps');
+}
+
+function testMalformed() {
+    // two good lanes, then a varint cut off
+    var bytes = encodeSplits([lane(360), lane(355)], 360);
+    bytes.push(0x80, 0xe8);
+    var workouts = { 7: workout(7, 20) };
+    var splits = { 7: bytes };
+
+    var rows = exportToString('exportCsv', workouts, splits).trim().split('\n').slice(1);
+    check(rows.length === 1 && /,,,,,$/.test(rows[0]), 'malformed splits: ' + rows.length + ' rows written');
+
+    var tcx = exportToString('exportTcx', workouts, splits);
+    check(tcx.split('<Lap ').length - 1 === 1 && tcx.indexOf('<DistanceMeters>500<') >= 0,
+          'malformed splits in TCX: not one lap of the whole workout');
+
+    check(!exporter.forEachSplit([9, 36, 0], function() {}), 'unknown version decoded');
+}
+
+//
+// benchmark
+
+// lanes near the target, a pause now and then, a restart and merged spans in a few
+function syntheticHistory(count) {
+    var workouts = {};
+    var splits = {};
+    for (var id = 0; id < count; ++id) {
+        var laneCount = 40 + (id * 37) % 160;
+        var target = 300 + (id * 13) % 200;
+        var records = [];
+        for (var i = 0; i < laneCount; ++i) {
+            if (i === 5 && id % 3 === 0) records.push(lane(90, { restart: true }));
+            records.push(lane(target + (i * 37) % 61 - 30, { pauseTime: i % 25 === 24 ? 600 : 0,
+                                                             laneSpan: id % 10 === 0 && i < 20 ? 2 : 1 }));
+        }
+        workouts[id] = workout(id, laneCount);
+        splits[id] = encodeSplits(records, target);
+    }
+    return { workouts: workouts, splits: splits };
+}
+
+function gc() {
+    if (global.gc) global.gc();
+}
+
+function measure(format, history) {
+    gc();
+    var baseline = process.memoryUsage().heapUsed;
+    var peak = baseline;
+    var bytes = 0;
+    var pieces = 0;
+
+    var start = process.hrtime();
+    exporter[format](history.workouts, history.splits, function(piece) {
+        bytes += piece.length;
+        if (++pieces % 16 === 0) peak = Math.max(peak, process.memoryUsage().heapUsed);
+    });
+    var elapsed = process.hrtime(start);
+    var ms = elapsed[0] * 1000 + elapsed[1] / 1e6;
+
+    console.log('  ' + format + ': ' + ms.toFixed(0) + ' ms, ' + (bytes / 1048576).toFixed(1) + ' MB in ' + pieces +
+                ' pieces, ' + (ms * 1000 / count).toFixed(1) + ' us per workout, peak heap +' +
+                ((peak - baseline) / 1048576).toFixed(1) + ' MB');
+}
+
+var count = parseInt(process.argv[2], 10) || 2000;
+
+console.log('== export of ' + count + ' workouts');
+testRestarts();
+testMalformed();
+
+gc();
+var before = process.memoryUsage().heapUsed;
+var history = syntheticHistory(count);
+gc();
+console.log('  history takes ' + ((process.memoryUsage().heapUsed - before) / 1048576).toFixed(1) + ' MB of heap');
+
+measure('exportCsv', history);
+measure('exportTcx', history);
+
+console.log('  ' + (failures ? 'FAILED' : 'ok'));
+process.exit(failures ? 1 : 0);
@@ -0,0 +1,72 @@
+// Checks the workout history: the count, the latest workout and the lookup by
+// date, also once the oldest workouts were dropped, and that adding a workout
+// rewrites only its record key and the index.
+//
+//   history_bench
+//
+// Exits with 1 if a check fails.
+
+#include "host.h"
+#include "history.h"
+
+#define START_TIME 1700000000
+#define WORKOUTS   (HISTORY_CAPACITY + 15)
+#define HOUR       3600
+
+static int failures = 0;
+
+static void check(bool condition, const char * message, int value)
+{
+    if (condition) return;
+    printf("  FAIL %s: %d\n", message, value);
+    ++failures;
+}
+
+static time_t startOf(int i)
+{
+    return START_TIME + i * HOUR;
+}
+
+int main()
+{
+    printf("== history of %d workouts in %d record keys\n", HISTORY_CAPACITY, (int)HISTORY_RECORD_KEYS);
+    Host_reset(START_TIME);
+
+    check(History_count() == 0, "workouts in a new history", History_count());
+    check(History_findByDate(startOf(0)) == -1, "found in a new history", History_findByDate(startOf(0)));
+
+    uint32_t writes = 0;
+    for (int i = 0; i < WORKOUTS; ++i) {
+        const HistoryRecord record = {
+            .startTime = startOf(i), .endTime = startOf(i) + 1800, .laneCount = 20 + i, .lengthOfLane = 25,
+        };
+        const uint32_t before = hostCounters.persistWrites;
+        History_add(&record);
+        writes += hostCounters.persistWrites - before;
+    }
+    check(writes == 2 * WORKOUTS, "persist writes for the workouts", writes);
+    check(History_count() == HISTORY_CAPACITY, "workouts kept", History_count());
+    check(History_id(0) == WORKOUTS - 1, "id of the latest", History_id(0));
+
+    HistoryRecord latest = { 0 };
+    check(History_get(0, &latest) && latest.startTime == startOf(WORKOUTS - 1), "start of the latest",
+          latest.startTime - START_TIME);
+
+    // every kept workout, at its start and while it runs
+    const int oldest = WORKOUTS - HISTORY_CAPACITY;
+    for (int i = oldest; i < WORKOUTS; ++i) {
+        const int age = WORKOUTS - 1 - i;
+        check(History_findByDate(startOf(i)) == age, "found at the start of a workout", i);
+        check(History_findByDate(startOf(i) + HOUR / 2) == age, "found within a workout", i);
+    }
+    check(History_findByDate(startOf(oldest) - 1) == -1, "found before the oldest kept", History_findByDate(startOf(oldest) - 1));
+    check(History_findByDate(startOf(WORKOUTS) * 2) == 0, "found in the future", History_findByDate(startOf(WORKOUTS) * 2));
+
+    HistoryRecord found = { 0 };
+    const int age = History_findByDate(startOf(oldest + 7));
+    check(History_get(age, &found) && found.laneCount == 20 + oldest + 7, "lanes of the workout found", found.laneCount);
+
+    printf("  %d workouts added, %.1f persist writes each\n", WORKOUTS, (double)writes / WORKOUTS);
+    printf("  %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,1499 @@
+#include "host.h"
+
+// The simulation itself allocates with the C library, the app's allocations
+// and the SDK objects it creates are counted.
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+#undef time
+
+HostCounters hostCounters;
+
+#define SCREEN_WIDTH  144
+#define SCREEN_HEIGHT 168
+
+#define MAX_WINDOWS      8
+#define MAX_MENUS        2
+#define MAX_PERSIST_KEYS 64
+#define PERSIST_STORAGE  4096
+#define APP_MESSAGE_MAX  8200
+#define DROP_TIMEOUT_MS  5000
+
+#define SHORT_PULSE_MS 250
+#define LONG_PULSE_MS  500
+
+//
+// heap
+
+typedef struct {
+    size_t size;
+    size_t padding; // keeps the block aligned
+} BlockHeader;
+
+static size_t heapLimit = 0;
+
+void * Host_malloc(size_t size)
+{
+    if (heapLimit && hostCounters.heapUsed + size > heapLimit) return NULL;
+
+    BlockHeader * header = malloc(sizeof(BlockHeader) + size);
+    if (!header) return NULL;
+    header->size = size;
+
+    ++hostCounters.allocs;
+    hostCounters.heapUsed += size;
+    if (hostCounters.heapUsed > hostCounters.heapPeak) hostCounters.heapPeak = hostCounters.heapUsed;
+    return header + 1;
+}
+
+void * Host_calloc(size_t count, size_t size)
+{
+    void * pointer = Host_malloc(count * size);
+    if (pointer) memset(pointer, 0, count * size);
+    return pointer;
+}
+
+void Host_free(void * pointer)
+{
+    if (!pointer) return;
+
+    BlockHeader * header = (BlockHeader *)pointer - 1;
+    ++hostCounters.frees;
+    hostCounters.heapUsed -= header->size;
+    free(header);
+}
+
+void * Host_realloc(void * pointer, size_t size)
+{
+    if (!pointer) return Host_malloc(size);
+
+    const size_t oldSize = ((BlockHeader *)pointer - 1)->size;
+    void * moved = Host_malloc(size);
+    if (!moved) return NULL;
+    memcpy(moved, pointer, oldSize < size ? oldSize : size);
+    Host_free(pointer);
+    return moved;
+}
+
+size_t heap_bytes_used(void)
+{
+    return hostCounters.heapUsed;
+}
+
+size_t heap_bytes_free(void)
+{
+    return heapLimit > hostCounters.heapUsed ? heapLimit - hostCounters.heapUsed : 0;
+}
+
+void Host_setHeapLimit(size_t bytes)
+{
+    heapLimit = bytes;
+}
+
+//
+// clock and timers
+
+static int64_t nowMs = 0;
+
+struct AppTimer {
+    int64_t due;
+    uint64_t sequence;
+    AppTimerCallback callback;
+    void * data;
+    bool internal; // part of the simulation, not an app wakeup
+    AppTimer * next;
+};
+
+static AppTimer * timers = NULL;
+static uint64_t timerSequence = 0;
+static HostCosts costs;
+
+void Host_setCosts(const HostCosts * newCosts)
+{
+    if (newCosts) costs = *newCosts;
+    else          memset(&costs, 0, sizeof(costs));
+}
+
+static void spend(uint32_t ms)
+{
+    nowMs += ms;
+    hostCounters.busyMs += ms;
+}
+
+int64_t Host_now()
+{
+    return nowMs;
+}
+
+time_t Host_time(time_t * seconds)
+{
+    const time_t now = nowMs / 1000;
+    if (seconds) *seconds = now;
+    return now;
+}
+
+uint16_t time_ms(time_t * seconds, uint16_t * ms)
+{
+    const uint16_t millis = nowMs % 1000;
+    if (seconds) *seconds = nowMs / 1000;
+    if (ms) *ms = millis;
+    return millis;
+}
+
+static AppTimer * addTimer(uint32_t timeoutMs, AppTimerCallback callback, void * data, bool internal)
+{
+    AppTimer * timer = internal ? calloc(1, sizeof(AppTimer)) : Host_calloc(1, sizeof(AppTimer));
+    if (!timer) return NULL;
+
+    timer->due      = nowMs + timeoutMs;
+    timer->sequence = timerSequence++;
+    timer->callback = callback;
+    timer->data     = data;
+    timer->internal = internal;
+    timer->next     = timers;
+    timers = timer;
+    return timer;
+}
+
+static bool unlinkTimer(AppTimer * timer)
+{
+    for (AppTimer ** link = &timers; *link; link = &(*link)->next) {
+        if (*link == timer) {
+            *link = timer->next;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void freeTimer(AppTimer * timer)
+{
+    if (timer->internal) free(timer);
+    else                 Host_free(timer);
+}
+
+AppTimer * app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void * callback_data)
+{
+    return addTimer(timeout_ms, callback, callback_data, false);
+}
+
+bool app_timer_reschedule(AppTimer * timer, uint32_t new_timeout_ms)
+{
+    if (!unlinkTimer(timer)) return false;
+    timer->due      = nowMs + new_timeout_ms;
+    timer->sequence = timerSequence++;
+    timer->next     = timers;
+    timers = timer;
+    return true;
+}
+
+void app_timer_cancel(AppTimer * timer)
+{
+    if (timer && unlinkTimer(timer)) freeTimer(timer);
+}
+
+void Host_runFor(uint32_t ms)
+{
+    const int64_t end = nowMs + ms;
+    for (;;) {
+        AppTimer * first = NULL;
+        for (AppTimer * timer = timers; timer; timer = timer->next) {
+            if (timer->due > end) continue;
+            if (!first || timer->due < first->due || (timer->due == first->due && timer->sequence < first->sequence)) {
+                first = timer;
+            }
+        }
+        if (!first) break;
+
+        unlinkTimer(first);
+        if (first->due > nowMs) nowMs = first->due;
+
+        const AppTimerCallback callback = first->callback;
+        void * data = first->data;
+        if (!first->internal) ++hostCounters.timerWakeups;
+        freeTimer(first);
+
+        callback(data);
+        Host_render();
+    }
+    if (nowMs < end) nowMs = end;
+}
+
+static void clearTimers()
+{
+    while (timers) {
+        AppTimer * timer = timers;
+        timers = timer->next;
+        if (timer->internal) free(timer);
+        else                 free((BlockHeader *)timer - 1); // the app's leak, not counted again
+    }
+}
+
+//
+// logging
+
+void Host_log(int level, const char * file, int line, const char * format, ...)
+{
+    static int maxLevel = -1;
+    if (maxLevel < 0) {
+        const char * env = getenv("HOST_LOG");
+        maxLevel = env ? atoi(env) : 0;
+        if (env && maxLevel == 0) maxLevel = APP_LOG_LEVEL_DEBUG;
+    }
+    if (level > maxLevel) return;
+
+    fprintf(stderr, "[%lld] %s:%d ", (long long)nowMs, file, line);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+//
+// bitmaps
+
+struct GBitmap {
+    uint32_t resourceId;
+    GRect bounds;
+    GBitmapFormat format;
+    uint16_t bytesPerRow;
+    GColor palette[4];
+    GColor * sharedPalette; // of the base bitmap for sub bitmaps
+    uint8_t * pixels;
+};
+
+typedef struct {
+    uint32_t resourceId;
+    int16_t width;
+    int16_t height;
+} ResourceInfo;
+
+// sizes of resources/images
+static const ResourceInfo resources[] = {
+    { RESOURCE_ID_IMAGE_ACTION_ICON_UP,    16, 16 },
+    { RESOURCE_ID_IMAGE_ACTION_ICON_OK,    16, 16 },
+    { RESOURCE_ID_IMAGE_ACTION_ICON_NOK,   18, 18 },
+    { RESOURCE_ID_IMAGE_ACTION_ICON_DOWN,  16, 16 },
+    { RESOURCE_ID_IMAGE_ACTION_ICON_PLAY,  16, 16 },
+    { RESOURCE_ID_IMAGE_ACTION_ICON_PAUSE, 16, 16 },
+    { RESOURCE_ID_CLOCK_DIGIT_ATLAS,       480, 71 },
+    { RESOURCE_ID_CLOCK_DIGIT_BOLD_ATLAS,  480, 71 },
+};
+
+GBitmap * gbitmap_create_with_resource(uint32_t resource_id)
+{
+    ++hostCounters.bitmapLoads;
+    spend(costs.bitmapLoadMs);
+
+    const ResourceInfo * info = NULL;
+    for (size_t i = 0; i < ARRAY_LENGTH(resources); ++i) {
+        if (resources[i].resourceId == resource_id) info = &resources[i];
+    }
+    if (!info) return NULL;
+
+    // the digits are anti-aliased with a 2 bit palette on color platforms
+#ifdef PBL_COLOR
+    const int bitsPerPixel = info->width > 100 ? 2 : 1;
+    const GBitmapFormat format = info->width > 100 ? GBitmapFormat2BitPalette : GBitmapFormat1BitPalette;
+#else
+    const int bitsPerPixel = 1;
+    const GBitmapFormat format = GBitmapFormat1Bit;
+#endif
+    const uint16_t bytesPerRow = (info->width * bitsPerPixel + 31) / 32 * 4;
+
+    GBitmap * bitmap = Host_calloc(1, sizeof(GBitmap));
+    if (!bitmap) return NULL;
+    bitmap->pixels = Host_calloc(1, bytesPerRow * info->height);
+    if (!bitmap->pixels) {
+        Host_free(bitmap);
+        return NULL;
+    }
+
+    bitmap->resourceId    = resource_id;
+    bitmap->bounds        = GRect(0, 0, info->width, info->height);
+    bitmap->format        = format;
+    bitmap->bytesPerRow   = bytesPerRow;
+    bitmap->sharedPalette = bitmap->palette;
+    return bitmap;
+}
+
+GBitmap * gbitmap_create_as_sub_bitmap(const GBitmap * base_bitmap, GRect sub_rect)
+{
+    ++hostCounters.subBitmaps;
+
+    GBitmap * bitmap = Host_calloc(1, sizeof(GBitmap));
+    if (!bitmap) return NULL;
+
+    *bitmap = *base_bitmap;
+    bitmap->bounds = sub_rect;
+    bitmap->pixels = NULL;
+    return bitmap;
+}
+
+void gbitmap_destroy(GBitmap * bitmap)
+{
+    if (!bitmap) return;
+    Host_free(bitmap->pixels);
+    Host_free(bitmap);
+}
+
+GColor * gbitmap_get_palette(const GBitmap * bitmap)
+{
+    return bitmap->sharedPalette;
+}
+
+GRect gbitmap_get_bounds(const GBitmap * bitmap)
+{
+    return bitmap->bounds;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap * bitmap)
+{
+    return bitmap->bytesPerRow;
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap * bitmap)
+{
+    return bitmap->format;
+}
+
+GFont fonts_get_system_font(const char * font_key)
+{
+    return (GFont)font_key;
+}
+
+//
+// layers
+
+typedef enum {
+    LAYER_ROOT,
+    LAYER_BITMAP,
+    LAYER_TEXT,
+    LAYER_MENU,
+    LAYER_ACTION_BAR,
+} LayerKind;
+
+struct Layer {
+    LayerKind kind;
+    Window * window;
+    GRect frame;
+    bool hidden;
+};
+
+struct BitmapLayer {
+    Layer layer;
+    const GBitmap * bitmap;
+};
+
+struct TextLayer {
+    Layer layer;
+    const char * text;
+};
+
+struct MenuLayer {
+    Layer layer;
+    MenuLayerCallbacks callbacks;
+    void * context;
+    MenuIndex selected;
+};
+
+struct ActionBarLayer {
+    Layer layer;
+    ClickConfigProvider clickConfigProvider;
+    const GBitmap * icons[NUM_BUTTONS];
+};
+
+typedef struct {
+    ClickHandler single;
+    ClickHandler multi;
+    uint8_t minClicks;
+    uint8_t maxClicks;
+} ButtonHandlers;
+
+struct Window {
+    Layer root;
+    WindowHandlers handlers;
+    bool loaded;
+    ClickConfigProvider clickConfigProvider;
+    void * clickContext;
+    ButtonHandlers buttons[NUM_BUTTONS];
+    MenuLayer * menus[MAX_MENUS];
+    ActionBarLayer * actionBar;
+};
+
+static Window * stack[MAX_WINDOWS];
+static int stackSize = 0;
+static bool dirty = false;
+
+// the window whose click config provider runs
+static Window * configuring = NULL;
+
+Window * Host_topWindow()
+{
+    return stackSize > 0 ? stack[stackSize - 1] : NULL;
+}
+
+int Host_windowCount()
+{
+    return stackSize;
+}
+
+static void markDirty(Layer * layer)
+{
+    ++hostCounters.markDirty;
+    if (layer->window && layer->window == Host_topWindow()) dirty = true;
+}
+
+void layer_mark_dirty(Layer * layer)
+{
+    markDirty(layer);
+}
+
+void layer_add_child(Layer * parent, Layer * child)
+{
+    child->window = parent->window;
+    if (child->kind == LAYER_MENU && parent->window) {
+        for (int i = 0; i < MAX_MENUS; ++i) {
+            if (!parent->window->menus[i]) {
+                parent->window->menus[i] = (MenuLayer *)child;
+                break;
+            }
+        }
+    }
+    markDirty(child);
+}
+
+static void removeFromWindow(Layer * layer)
+{
+    Window * window = layer->window;
+    if (!window) return;
+
+    for (int i = 0; i < MAX_MENUS; ++i) {
+        if (window->menus[i] == (MenuLayer *)layer) window->menus[i] = NULL;
+    }
+    markDirty(&window->root);
+    layer->window = NULL;
+}
+
+void layer_set_hidden(Layer * layer, bool hidden)
+{
+    if (layer->hidden == hidden) return;
+    layer->hidden = hidden;
+    markDirty(layer);
+}
+
+bool layer_get_hidden(const Layer * layer)
+{
+    return layer->hidden;
+}
+
+void layer_set_frame(Layer * layer, GRect frame)
+{
+    layer->frame = frame;
+    markDirty(layer);
+}
+
+GRect layer_get_frame(const Layer * layer)
+{
+    return layer->frame;
+}
+
+GRect layer_get_bounds(const Layer * layer)
+{
+    return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+BitmapLayer * bitmap_layer_create(GRect frame)
+{
+    BitmapLayer * bitmapLayer = Host_calloc(1, sizeof(BitmapLayer));
+    if (!bitmapLayer) return NULL;
+    bitmapLayer->layer.kind  = LAYER_BITMAP;
+    bitmapLayer->layer.frame = frame;
+    return bitmapLayer;
+}
+
+void bitmap_layer_destroy(BitmapLayer * bitmap_layer)
+{
+    if (!bitmap_layer) return;
+    removeFromWindow(&bitmap_layer->layer);
+    Host_free(bitmap_layer);
+}
+
+Layer * bitmap_layer_get_layer(const BitmapLayer * bitmap_layer)
+{
+    return (Layer *)&bitmap_layer->layer;
+}
+
+void bitmap_layer_set_bitmap(BitmapLayer * bitmap_layer, const GBitmap * bitmap)
+{
+    bitmap_layer->bitmap = bitmap;
+    markDirty(&bitmap_layer->layer);
+}
+
+TextLayer * text_layer_create(GRect frame)
+{
+    TextLayer * textLayer = Host_calloc(1, sizeof(TextLayer));
+    if (!textLayer) return NULL;
+    textLayer->layer.kind  = LAYER_TEXT;
+    textLayer->layer.frame = frame;
+    return textLayer;
+}
+
+void text_layer_destroy(TextLayer * text_layer)
+{
+    if (!text_layer) return;
+    removeFromWindow(&text_layer->layer);
+    Host_free(text_layer);
+}
+
+Layer * text_layer_get_layer(TextLayer * text_layer)
+{
+    return &text_layer->layer;
+}
+
+void text_layer_set_text(TextLayer * text_layer, const char * text)
+{
+    text_layer->text = text;
+    markDirty(&text_layer->layer);
+}
+
+void text_layer_set_background_color(TextLayer * text_layer, GColor color)
+{
+    markDirty(&text_layer->layer);
+}
+
+void text_layer_set_text_alignment(TextLayer * text_layer, GTextAlignment text_alignment)
+{
+    markDirty(&text_layer->layer);
+}
+
+void text_layer_set_font(TextLayer * text_layer, GFont font)
+{
+    markDirty(&text_layer->layer);
+}
+
+// about 9 pixels per character and 28 per line of the 24 point font
+GSize text_layer_get_content_size(TextLayer * text_layer)
+{
+    const int width  = text_layer->layer.frame.size.w > 0 ? text_layer->layer.frame.size.w : SCREEN_WIDTH;
+    const int length = text_layer->text ? (int)strlen(text_layer->text) * 9 : 0;
+    return GSize(length < width ? length : width, (length / width + 1) * 28);
+}
+
+//
+// clicks
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler)
+{
+    if (configuring) configuring->buttons[button_id].single = handler;
+}
+
+void window_single_repeating_click_subscribe(ButtonId button_id, uint16_t repeat_interval_ms, ClickHandler handler)
+{
+    if (configuring) configuring->buttons[button_id].single = handler;
+}
+
+void window_multi_click_subscribe(ButtonId button_id, uint8_t min_clicks, uint8_t max_clicks, uint16_t timeout,
+                                  bool last_click_only, ClickHandler handler)
+{
+    if (!configuring) return;
+    configuring->buttons[button_id].multi     = handler;
+    configuring->buttons[button_id].minClicks = min_clicks;
+    configuring->buttons[button_id].maxClicks = max_clicks ? max_clicks : min_clicks;
+}
+
+// runs the click config of the top window, as the watch does when it gets on top
+static void configureClicks(Window * window)
+{
+    if (!window || window != Host_topWindow()) return;
+
+    memset(window->buttons, 0, sizeof(window->buttons));
+    if (!window->clickConfigProvider) return;
+
+    Window * previous = configuring;
+    configuring = window;
+    window->clickConfigProvider(window->clickContext);
+    configuring = previous;
+}
+
+void Host_press(ButtonId button)
+{
+    Window * window = Host_topWindow();
+    if (!window) return;
+
+    if (window->buttons[button].single) {
+        window->buttons[button].single(NULL, window->clickContext);
+    } else if (button == BUTTON_ID_BACK) {
+        window_stack_pop(true);
+    }
+    Host_render();
+}
+
+void Host_multiPress(ButtonId button, uint8_t count)
+{
+    Window * window = Host_topWindow();
+    if (!window) return;
+
+    const ButtonHandlers * handlers = &window->buttons[button];
+    if (handlers->multi && count >= handlers->minClicks && count <= handlers->maxClicks) {
+        handlers->multi(NULL, window->clickContext);
+        Host_render();
+        return;
+    }
+    for (uint8_t i = 0; i < count; ++i) Host_press(button);
+}
+
+//
+// windows
+
+Window * window_create(void)
+{
+    Window * window = Host_calloc(1, sizeof(Window));
+    if (!window) return NULL;
+    window->root.kind   = LAYER_ROOT;
+    window->root.window = window;
+    window->root.frame  = GRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    return window;
+}
+
+static void removeFromStack(Window * window)
+{
+    for (int i = 0; i < stackSize; ++i) {
+        if (stack[i] != window) continue;
+
+        const bool wasTop = i == stackSize - 1;
+        if (wasTop && window->handlers.disappear) window->handlers.disappear(window);
+        memmove(&stack[i], &stack[i + 1], (stackSize - i - 1) * sizeof(Window *));
+        --stackSize;
+
+        if (window->loaded) {
+            window->loaded = false;
+            if (window->handlers.unload) window->handlers.unload(window);
+        }
+
+        Window * top = Host_topWindow();
+        if (wasTop && top) {
+            if (top->handlers.appear) top->handlers.appear(top);
+            configureClicks(top);
+        }
+        dirty = true;
+        return;
+    }
+}
+
+void window_destroy(Window * window)
+{
+    if (!window) return;
+    removeFromStack(window);
+    Host_free(window);
+}
+
+void window_set_window_handlers(Window * window, WindowHandlers handlers)
+{
+    window->handlers = handlers;
+}
+
+void window_set_background_color(Window * window, GColor background_color)
+{
+    markDirty(&window->root);
+}
+
+Layer * window_get_root_layer(const Window * window)
+{
+    return (Layer *)&window->root;
+}
+
+void window_set_click_config_provider(Window * window, ClickConfigProvider click_config_provider)
+{
+    window_set_click_config_provider_with_context(window, click_config_provider, window);
+}
+
+void window_set_click_config_provider_with_context(Window * window, ClickConfigProvider click_config_provider,
+                                                   void * context)
+{
+    window->clickConfigProvider = click_config_provider;
+    window->clickContext        = context;
+    configureClicks(window);
+}
+
+ClickConfigProvider window_get_click_config_provider(const Window * window)
+{
+    return window->clickConfigProvider;
+}
+
+void * window_get_click_config_context(Window * window)
+{
+    return window->clickContext;
+}
+
+void window_stack_push(Window * window, bool animated)
+{
+    if (stackSize == MAX_WINDOWS) return;
+
+    Window * covered = Host_topWindow();
+    if (covered && covered->handlers.disappear) covered->handlers.disappear(covered);
+
+    stack[stackSize++] = window;
+    ++hostCounters.windowPushes;
+
+    if (!window->loaded) {
+        window->loaded = true;
+        if (window->handlers.load) window->handlers.load(window);
+    }
+    if (window->handlers.appear) window->handlers.appear(window);
+    configureClicks(window);
+    dirty = true;
+}
+
+Window * window_stack_pop(bool animated)
+{
+    Window * top = Host_topWindow();
+    if (top) removeFromStack(top);
+    return top;
+}
+
+void window_stack_pop_all(bool animated)
+{
+    while (stackSize > 0) window_stack_pop(animated);
+}
+
+bool window_stack_contains_window(Window * window)
+{
+    for (int i = 0; i < stackSize; ++i) {
+        if (stack[i] == window) return true;
+    }
+    return false;
+}
+
+Window * window_stack_get_top_window(void)
+{
+    return Host_topWindow();
+}
+
+//
+// action bar
+
+ActionBarLayer * action_bar_layer_create(void)
+{
+    ActionBarLayer * actionBar = Host_calloc(1, sizeof(ActionBarLayer));
+    if (!actionBar) return NULL;
+    actionBar->layer.kind  = LAYER_ACTION_BAR;
+    actionBar->layer.frame = GRect(SCREEN_WIDTH - ACTION_BAR_WIDTH, 0, ACTION_BAR_WIDTH, SCREEN_HEIGHT);
+    return actionBar;
+}
+
+void action_bar_layer_remove_from_window(ActionBarLayer * action_bar)
+{
+    Window * window = action_bar->layer.window;
+    if (!window) return;
+
+    window->actionBar = NULL;
+    removeFromWindow(&action_bar->layer);
+    window_set_click_config_provider_with_context(window, NULL, NULL);
+}
+
+void action_bar_layer_destroy(ActionBarLayer * action_bar)
+{
+    if (!action_bar) return;
+    action_bar_layer_remove_from_window(action_bar);
+    Host_free(action_bar);
+}
+
+void action_bar_layer_add_to_window(ActionBarLayer * action_bar, Window * window)
+{
+    window->actionBar = action_bar;
+    action_bar->layer.window = window;
+    markDirty(&action_bar->layer);
+    window_set_click_config_provider_with_context(window, action_bar->clickConfigProvider, action_bar);
+}
+
+void action_bar_layer_set_click_config_provider(ActionBarLayer * action_bar, ClickConfigProvider click_config_provider)
+{
+    action_bar->clickConfigProvider = click_config_provider;
+    if (action_bar->layer.window) {
+        window_set_click_config_provider_with_context(action_bar->layer.window, click_config_provider, action_bar);
+    }
+}
+
+void action_bar_layer_set_icon(ActionBarLayer * action_bar, ButtonId button_id, const GBitmap * icon)
+{
+    if (action_bar->icons[button_id] == icon) return;
+    action_bar->icons[button_id] = icon;
+    markDirty(&action_bar->layer);
+}
+
+void action_bar_layer_set_icon_animated(ActionBarLayer * action_bar, ButtonId button_id, const GBitmap * icon,
+                                        bool animated)
+{
+    action_bar_layer_set_icon(action_bar, button_id, icon);
+}
+
+//
+// menu
+
+#define MENU_CELL_HEIGHT 44
+
+static uint16_t sectionCount(MenuLayer * menu)
+{
+    return menu->callbacks.get_num_sections ? menu->callbacks.get_num_sections(menu, menu->context) : 1;
+}
+
+static uint16_t rowCount(MenuLayer * menu, uint16_t section)
+{
+    return menu->callbacks.get_num_rows ? menu->callbacks.get_num_rows(menu, section, menu->context) : 0;
+}
+
+static void onMenuUp(ClickRecognizerRef recognizer, void * context)
+{
+    MenuLayer * menu = context;
+    if (menu->selected.row > 0) {
+        --menu->selected.row;
+    } else if (menu->selected.section > 0) {
+        --menu->selected.section;
+        const uint16_t rows = rowCount(menu, menu->selected.section);
+        menu->selected.row = rows > 0 ? rows - 1 : 0;
+    }
+    markDirty(&menu->layer);
+}
+
+static void onMenuDown(ClickRecognizerRef recognizer, void * context)
+{
+    MenuLayer * menu = context;
+    if (menu->selected.row + 1 < rowCount(menu, menu->selected.section)) {
+        ++menu->selected.row;
+    } else if (menu->selected.section + 1 < sectionCount(menu)) {
+        ++menu->selected.section;
+        menu->selected.row = 0;
+    }
+    markDirty(&menu->layer);
+}
+
+static void onMenuSelect(ClickRecognizerRef recognizer, void * context)
+{
+    MenuLayer * menu = context;
+    if (menu->callbacks.select_click) menu->callbacks.select_click(menu, &menu->selected, menu->context);
+}
+
+static void menuClickConfigProvider(void * context)
+{
+    window_single_repeating_click_subscribe(BUTTON_ID_UP,   100, onMenuUp);
+    window_single_repeating_click_subscribe(BUTTON_ID_DOWN, 100, onMenuDown);
+    window_single_click_subscribe(BUTTON_ID_SELECT, onMenuSelect);
+}
+
+MenuLayer * menu_layer_create(GRect frame)
+{
+    MenuLayer * menu = Host_calloc(1, sizeof(MenuLayer));
+    if (!menu) return NULL;
+    menu->layer.kind  = LAYER_MENU;
+    menu->layer.frame = frame;
+    return menu;
+}
+
+void menu_layer_destroy(MenuLayer * menu_layer)
+{
+    if (!menu_layer) return;
+    removeFromWindow(&menu_layer->layer);
+    Host_free(menu_layer);
+}
+
+Layer * menu_layer_get_layer(const MenuLayer * menu_layer)
+{
+    return (Layer *)&menu_layer->layer;
+}
+
+void menu_layer_set_callbacks(MenuLayer * menu_layer, void * callback_context, MenuLayerCallbacks callbacks)
+{
+    menu_layer->callbacks = callbacks;
+    menu_layer->context   = callback_context;
+    markDirty(&menu_layer->layer);
+}
+
+void menu_layer_set_click_config_onto_window(MenuLayer * menu_layer, Window * window)
+{
+    window_set_click_config_provider_with_context(window, menuClickConfigProvider, menu_layer);
+}
+
+void menu_layer_reload_data(MenuLayer * menu_layer)
+{
+    markDirty(&menu_layer->layer);
+}
+
+void menu_cell_basic_draw(GContext * ctx, const Layer * cell_layer, const char * title, const char * subtitle,
+                          GBitmap * icon)
+{
+}
+
+void menu_cell_basic_header_draw(GContext * ctx, const Layer * cell_layer, const char * title)
+{
+}
+
+// draws the headers and rows that fit on the screen, the selected one in view
+static void drawMenu(MenuLayer * menu)
+{
+    Layer cell = { .kind = LAYER_ROOT, .window = menu->layer.window };
+    const int height = menu->layer.frame.size.h > 0 ? menu->layer.frame.size.h : SCREEN_HEIGHT;
+    int y = 0;
+
+    const uint16_t sections = sectionCount(menu);
+    for (uint16_t section = menu->selected.section; section < sections && y < height; ++section) {
+        const int16_t headerHeight = menu->callbacks.get_header_height
+                                   ? menu->callbacks.get_header_height(menu, section, menu->context) : 0;
+        if (headerHeight > 0 && menu->callbacks.draw_header) {
+            cell.frame = GRect(0, y, menu->layer.frame.size.w, headerHeight);
+            menu->callbacks.draw_header(NULL, &cell, section, menu->context);
+            ++hostCounters.rowsDrawn;
+            y += headerHeight;
+        }
+
+        const uint16_t rows = rowCount(menu, section);
+        const uint16_t firstRow = section == menu->selected.section ? menu->selected.row : 0;
+        for (uint16_t row = firstRow; row < rows && y < height; ++row) {
+            MenuIndex index = { section, row };
+            const int16_t cellHeight = menu->callbacks.get_cell_height
+                                     ? menu->callbacks.get_cell_height(menu, &index, menu->context) : MENU_CELL_HEIGHT;
+            cell.frame = GRect(0, y, menu->layer.frame.size.w, cellHeight);
+            if (menu->callbacks.draw_row) menu->callbacks.draw_row(NULL, &cell, &index, menu->context);
+            ++hostCounters.rowsDrawn;
+            y += cellHeight;
+        }
+    }
+}
+
+void Host_render()
+{
+    Window * window = Host_topWindow();
+    if (!dirty || !window) return;
+
+    dirty = false;
+    ++hostCounters.frames;
+    spend(costs.frameMs);
+    for (int i = 0; i < MAX_MENUS; ++i) {
+        if (window->menus[i] && !window->menus[i]->layer.hidden) drawMenu(window->menus[i]);
+    }
+}
+
+bool Host_menuSelect(uint16_t section, uint16_t row)
+{
+    Window * window = Host_topWindow();
+    if (!window || !window->menus[0]) return false;
+
+    MenuLayer * menu = window->menus[0];
+    if (section >= sectionCount(menu) || row >= rowCount(menu, section)) return false;
+
+    menu->selected = (MenuIndex){ section, row };
+    markDirty(&menu->layer);
+    Host_press(BUTTON_ID_SELECT);
+    return true;
+}
+
+//
+// event loop
+
+static void (*eventLoop)() = NULL;
+
+void Host_setEventLoop(void (*loop)())
+{
+    eventLoop = loop;
+}
+
+void app_event_loop(void)
+{
+    Host_render();
+    if (eventLoop) eventLoop();
+}
+
+//
+// vibes and sensors
+
+void vibes_short_pulse(void)
+{
+    ++hostCounters.vibes;
+    hostCounters.vibeMs += SHORT_PULSE_MS;
+}
+
+void vibes_long_pulse(void)
+{
+    ++hostCounters.vibes;
+    hostCounters.vibeMs += LONG_PULSE_MS;
+}
+
+void vibes_double_pulse(void)
+{
+    ++hostCounters.vibes;
+    hostCounters.vibeMs += 2 * SHORT_PULSE_MS;
+}
+
+void vibes_enqueue_custom_pattern(VibePattern pattern)
+{
+    ++hostCounters.vibes;
+    for (uint32_t i = 0; i < pattern.num_segments; i += 2) {
+        hostCounters.vibeMs += pattern.durations[i];
+    }
+}
+
+void vibes_cancel(void)
+{
+}
+
+static AccelDataHandler accelHandler = NULL;
+
+void accel_data_service_subscribe(uint32_t samples_per_update, AccelDataHandler handler)
+{
+    accelHandler = handler;
+}
+
+void accel_data_service_unsubscribe(void)
+{
+    accelHandler = NULL;
+}
+
+int accel_service_set_sampling_rate(AccelSamplingRate rate)
+{
+    return 0;
+}
+
+void Host_feedAccel(AccelData * samples, uint32_t count)
+{
+    if (!accelHandler) return;
+    ++hostCounters.accelWakeups;
+    accelHandler(samples, count);
+    Host_render();
+}
+
+//
+// persist
+
+typedef struct {
+    bool used;
+    uint32_t key;
+    uint16_t size;
+    uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} PersistEntry;
+
+static PersistEntry persist[MAX_PERSIST_KEYS];
+
+static PersistEntry * findEntry(uint32_t key)
+{
+    for (int i = 0; i < MAX_PERSIST_KEYS; ++i) {
+        if (persist[i].used && persist[i].key == key) return &persist[i];
+    }
+    return NULL;
+}
+
+static int storageUsed()
+{
+    int used = 0;
+    for (int i = 0; i < MAX_PERSIST_KEYS; ++i) {
+        if (persist[i].used) used += persist[i].size;
+    }
+    return used;
+}
+
+bool persist_exists(uint32_t key)
+{
+    ++hostCounters.persistReads;
+    spend(costs.persistReadMs);
+    return findEntry(key) != NULL;
+}
+
+int persist_get_size(uint32_t key)
+{
+    ++hostCounters.persistReads;
+    spend(costs.persistReadMs);
+    const PersistEntry * entry = findEntry(key);
+    return entry ? entry->size : E_DOES_NOT_EXIST;
+}
+
+int persist_read_data(uint32_t key, void * buffer, size_t buffer_size)
+{
+    ++hostCounters.persistReads;
+    spend(costs.persistReadMs);
+    const PersistEntry * entry = findEntry(key);
+    if (!entry) return E_DOES_NOT_EXIST;
+
+    const size_t size = entry->size < buffer_size ? entry->size : buffer_size;
+    memcpy(buffer, entry->data, size);
+    return size;
+}
+
+int32_t persist_read_int(uint32_t key)
+{
+    int32_t value = 0;
+    return persist_read_data(key, &value, sizeof(value)) == sizeof(value) ? value : 0;
+}
+
+int persist_write_data(uint32_t key, const void * data, size_t size)
+{
+    ++hostCounters.persistWrites;
+    spend(costs.persistWriteMs);
+    if (size > PERSIST_DATA_MAX_LENGTH) size = PERSIST_DATA_MAX_LENGTH;
+
+    PersistEntry * entry = findEntry(key);
+    const int otherKeys = storageUsed() - (entry ? entry->size : 0);
+    if (otherKeys + (int)size > PERSIST_STORAGE) return E_OUT_OF_STORAGE;
+
+    for (int i = 0; !entry && i < MAX_PERSIST_KEYS; ++i) {
+        if (!persist[i].used) entry = &persist[i];
+    }
+    if (!entry) return E_OUT_OF_STORAGE;
+
+    entry->used = true;
+    entry->key  = key;
+    entry->size = size;
+    memcpy(entry->data, data, size);
+    hostCounters.persistBytesWritten += size;
+    return size;
+}
+
+status_t persist_write_int(uint32_t key, int32_t value)
+{
+    const int written = persist_write_data(key, &value, sizeof(value));
+    return written < 0 ? written : S_SUCCESS;
+}
+
+status_t persist_delete(uint32_t key)
+{
+    ++hostCounters.persistWrites;
+    spend(costs.persistWriteMs);
+    PersistEntry * entry = findEntry(key);
+    if (!entry) return E_DOES_NOT_EXIST;
+    entry->used = false;
+    return S_SUCCESS;
+}
+
+size_t Host_savePersist(void * buffer, size_t size)
+{
+    if (size < sizeof(persist)) return 0;
+    memcpy(buffer, persist, sizeof(persist));
+    return sizeof(persist);
+}
+
+void Host_loadPersist(const void * buffer, size_t size)
+{
+    if (size == sizeof(persist)) memcpy(persist, buffer, sizeof(persist));
+}
+
+//
+// worker
+
+static bool workerRunning = false;
+
+void Host_setWorkerRunning(bool running)
+{
+    workerRunning = running;
+}
+
+bool app_worker_is_running(void)
+{
+    return workerRunning;
+}
+
+AppWorkerResult app_worker_launch(void)
+{
+    if (workerRunning) return APP_WORKER_RESULT_ALREADY_RUNNING;
+    workerRunning = true;
+    return APP_WORKER_RESULT_SUCCESS;
+}
+
+AppWorkerResult app_worker_kill(void)
+{
+    if (!workerRunning) return APP_WORKER_RESULT_NOT_RUNNING;
+    workerRunning = false;
+    return APP_WORKER_RESULT_SUCCESS;
+}
+
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler)
+{
+    return true;
+}
+
+bool app_worker_message_unsubscribe(void)
+{
+    return true;
+}
+
+void app_worker_send_message(uint8_t type, AppWorkerMessage * data)
+{
+    ++hostCounters.workerMessages;
+}
+
+//
+// dictionaries
+
+#define TUPLE_HEADER_SIZE 7
+
+static DictionaryResult writeTuple(DictionaryIterator * iter, uint32_t key, TupleType type, const void * data,
+                                   uint16_t size)
+{
+    if (!iter->cursor || iter->cursor + TUPLE_HEADER_SIZE + size > iter->end) return DICT_NOT_ENOUGH_STORAGE;
+
+    Tuple * tuple = (Tuple *)iter->cursor;
+    tuple->key    = key;
+    tuple->type   = type;
+    tuple->length = size;
+    if (size > 0) memcpy(tuple->value->data, data, size);
+
+    iter->cursor += TUPLE_HEADER_SIZE + size;
+    ++iter->begin[0];
+    return DICT_OK;
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator * iter, uint32_t key, int32_t value)
+{
+    return writeTuple(iter, key, TUPLE_INT, &value, sizeof(value));
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator * iter, uint32_t key, uint32_t value)
+{
+    return writeTuple(iter, key, TUPLE_UINT, &value, sizeof(value));
+}
+
+DictionaryResult dict_write_data(DictionaryIterator * iter, uint32_t key, const uint8_t * data, uint16_t size)
+{
+    return writeTuple(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+uint32_t dict_write_end(DictionaryIterator * iter)
+{
+    return iter->cursor ? (uint32_t)(iter->cursor - iter->begin) : 0;
+}
+
+Tuple * dict_find(const DictionaryIterator * iter, uint32_t key)
+{
+    uint8_t * cursor = iter->begin + 1;
+    for (uint8_t i = 0; i < iter->begin[0]; ++i) {
+        Tuple * tuple = (Tuple *)cursor;
+        if (tuple->key == key) return tuple;
+        cursor += TUPLE_HEADER_SIZE + tuple->length;
+    }
+    return NULL;
+}
+
+uint32_t dict_calc_buffer_size(uint8_t tuple_count, ...)
+{
+    uint32_t size = 1 + tuple_count * TUPLE_HEADER_SIZE;
+    va_list sizes;
+    va_start(sizes, tuple_count);
+    for (uint8_t i = 0; i < tuple_count; ++i) size += va_arg(sizes, uint32_t);
+    va_end(sizes);
+    return size;
+}
+
+static void startDict(DictionaryIterator * iter, uint8_t * buffer, size_t size)
+{
+    iter->begin  = buffer;
+    iter->end    = buffer + size;
+    iter->cursor = buffer + 1;
+    buffer[0] = 0;
+}
+
+//
+// AppMessage loopback
+
+static bool appMessageOpen = false;
+static bool connected = true;
+static uint32_t outboxSize = 0;
+static uint8_t outbox[APP_MESSAGE_MAX];
+static DictionaryIterator outboxIter;
+static bool outboxBegun = false;
+static bool outboxBusy = false;
+
+static AppMessageInboxReceived inboxReceived = NULL;
+static AppMessageOutboxSent outboxSent = NULL;
+static AppMessageOutboxFailed outboxFailed = NULL;
+static ConnectionHandlers connectionHandlers;
+
+static HostOutboxHandler outboxHandler = NULL;
+static uint32_t latencyMs = 50;
+
+// frames to the app: the one being built and the ones on the way
+typedef struct {
+    uint8_t buffer[APP_MESSAGE_MAX];
+    DictionaryIterator iter;
+} InboxFrame;
+
+static InboxFrame inboxDraft;
+
+AppMessageResult app_message_open(uint32_t size_inbound, uint32_t size_outbound)
+{
+    appMessageOpen = true;
+    outboxSize = size_outbound < APP_MESSAGE_MAX ? size_outbound : APP_MESSAGE_MAX;
+    return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum(void)
+{
+    return APP_MESSAGE_MAX;
+}
+
+uint32_t app_message_outbox_size_maximum(void)
+{
+    return APP_MESSAGE_MAX;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator ** iterator)
+{
+    if (!appMessageOpen) return APP_MSG_CLOSED;
+    if (outboxBusy) return APP_MSG_BUSY;
+
+    startDict(&outboxIter, outbox, outboxSize);
+    outboxBegun = true;
+    *iterator = &outboxIter;
+    return APP_MSG_OK;
+}
+
+static void onOutboxFailedTimer(void * data)
+{
+    outboxBusy = false;
+    if (outboxFailed) outboxFailed(&outboxIter, (AppMessageResult)(intptr_t)data, NULL);
+}
+
+static void onOutboxArrived(void * data)
+{
+    outboxIter.cursor = outbox + 1;
+    const HostDelivery delivery = outboxHandler ? outboxHandler(&outboxIter) : HOST_DELIVER;
+    switch (delivery) {
+    case HOST_DELIVER:
+        outboxBusy = false;
+        if (outboxSent) outboxSent(&outboxIter, NULL);
+        break;
+    case HOST_NACK:
+        onOutboxFailedTimer((void *)(intptr_t)APP_MSG_SEND_REJECTED);
+        break;
+    case HOST_DROP:
+        addTimer(DROP_TIMEOUT_MS, onOutboxFailedTimer, (void *)(intptr_t)APP_MSG_SEND_TIMEOUT, true);
+        break;
+    }
+}
+
+AppMessageResult app_message_outbox_send(void)
+{
+    if (!outboxBegun) return APP_MSG_CLOSED;
+    if (!connected) return APP_MSG_NOT_CONNECTED;
+
+    outboxBegun = false;
+    outboxBusy  = true;
+    ++hostCounters.appMessagesSent;
+    addTimer(latencyMs, onOutboxArrived, NULL, true);
+    return APP_MSG_OK;
+}
+
+void app_message_register_inbox_received(AppMessageInboxReceived received_callback)
+{
+    inboxReceived = received_callback;
+}
+
+void app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback)
+{
+}
+
+void app_message_register_outbox_sent(AppMessageOutboxSent sent_callback)
+{
+    outboxSent = sent_callback;
+}
+
+void app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback)
+{
+    outboxFailed = failed_callback;
+}
+
+void app_message_deregister_callbacks(void)
+{
+    inboxReceived = NULL;
+    outboxSent    = NULL;
+    outboxFailed  = NULL;
+}
+
+void Host_setOutboxHandler(HostOutboxHandler handler, uint32_t latency)
+{
+    outboxHandler = handler;
+    latencyMs = latency;
+}
+
+DictionaryIterator * Host_dictBegin()
+{
+    startDict(&inboxDraft.iter, inboxDraft.buffer, sizeof(inboxDraft.buffer));
+    return &inboxDraft.iter;
+}
+
+static void onInboxArrived(void * data)
+{
+    InboxFrame * frame = data;
+    frame->iter.begin  = frame->buffer;
+    frame->iter.end    = frame->buffer + sizeof(frame->buffer);
+    frame->iter.cursor = frame->buffer + 1;
+    if (inboxReceived && connected) inboxReceived(&frame->iter, NULL);
+    free(frame);
+}
+
+void Host_dictSend(bool dropped)
+{
+    if (dropped) return;
+
+    InboxFrame * frame = malloc(sizeof(InboxFrame));
+    memcpy(frame->buffer, inboxDraft.buffer, sizeof(frame->buffer));
+    addTimer(latencyMs, onInboxArrived, frame, true);
+}
+
+void connection_service_subscribe(ConnectionHandlers handlers)
+{
+    connectionHandlers = handlers;
+}
+
+void connection_service_unsubscribe(void)
+{
+    memset(&connectionHandlers, 0, sizeof(connectionHandlers));
+}
+
+bool connection_service_peek_pebble_app_connection(void)
+{
+    return connected;
+}
+
+void Host_setConnected(bool isConnected)
+{
+    if (connected == isConnected) return;
+    connected = isConnected;
+    if (connectionHandlers.pebble_app_connection_handler) connectionHandlers.pebble_app_connection_handler(connected);
+    Host_render();
+}
+
+//
+// reset
+
+void Host_resetCounters()
+{
+    const size_t heapUsed = hostCounters.heapUsed;
+    memset(&hostCounters, 0, sizeof(hostCounters));
+    hostCounters.heapUsed = heapUsed;
+    hostCounters.heapPeak = heapUsed;
+}
+
+void Host_reset(time_t startSeconds)
+{
+    clearTimers();
+    stackSize = 0;
+    dirty = false;
+    configuring = NULL;
+    memset(persist, 0, sizeof(persist));
+    memset(&hostCounters, 0, sizeof(hostCounters));
+
+    nowMs = (int64_t)startSeconds * 1000;
+    Host_setCosts(NULL);
+    heapLimit = 0;
+    eventLoop = NULL;
+    accelHandler = NULL;
+    workerRunning = false;
+
+    appMessageOpen = false;
+    connected = true;
+    outboxBegun = false;
+    outboxBusy = false;
+    app_message_deregister_callbacks();
+    memset(&connectionHandlers, 0, sizeof(connectionHandlers));
+    outboxHandler = NULL;
+    latencyMs = 50;
+}
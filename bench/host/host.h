@@ -0,0 +1,109 @@
+#pragma once
+
+// Control of the simulated watch of host.c, for the benchmarks and tests.
+// Time is virtual: it only advances in Host_runFor(), which fires the due
+// timers in order and draws a frame after each event that dirtied a layer,
+// and by the costs of Host_setCosts().
+
+#include "pebble.h"
+
+// What the app cost on the simulated watch since the last reset
+typedef struct {
+    uint32_t bitmapLoads;     // gbitmap_create_with_resource
+    uint32_t subBitmaps;      // gbitmap_create_as_sub_bitmap
+    uint32_t markDirty;       // layer_mark_dirty, also the ones of the SDK setters
+    uint32_t frames;          // frames drawn
+    uint32_t rowsDrawn;       // menu rows and headers drawn
+    uint32_t persistReads;    // persist_exists, _get_size and _read_*
+    uint32_t persistWrites;   // persist_write_* and _delete
+    uint32_t persistBytesWritten;
+    uint32_t vibes;           // vibes_* except vibes_cancel
+    uint32_t vibeMs;
+    uint32_t timerWakeups;    // app timer callbacks run
+    uint32_t accelWakeups;    // accel handler calls
+    uint32_t windowPushes;
+    uint32_t workerMessages;
+    uint32_t appMessagesSent;
+    uint32_t allocs;          // malloc, calloc and realloc of the app and the SDK objects
+    uint32_t frees;
+    uint32_t busyMs;          // virtual time spent by the costs of Host_setCosts()
+    size_t   heapUsed;
+    size_t   heapPeak;
+} HostCounters;
+
+extern HostCounters hostCounters;
+
+// Clears the simulated watch: windows, timers, persist, callbacks and the
+// counters. The clock starts at the given wall clock time.
+void Host_reset(time_t startSeconds);
+
+// Clears the counters only; the heap peak restarts at the current use
+void Host_resetCounters();
+
+// virtual wall clock in milliseconds
+int64_t Host_now();
+
+// Virtual time the watch spends in the SDK calls of the app, so the clock
+// also moves while the app works outside of timers. All 0, the default of
+// Host_reset(), keeps the clock still.
+typedef struct {
+    uint32_t persistReadMs;   // per persist read, as counted
+    uint32_t persistWriteMs;  // per persist write or delete
+    uint32_t bitmapLoadMs;    // per gbitmap_create_with_resource
+    uint32_t frameMs;         // per frame drawn
+} HostCosts;
+
+void Host_setCosts(const HostCosts * costs);
+
+// Heap the app may use, allocations beyond it fail; 0 for no limit
+void Host_setHeapLimit(size_t bytes);
+
+// Is called by app_event_loop(), which returns when it returns
+void Host_setEventLoop(void (*eventLoop)());
+
+// Runs the timers due within the next ms milliseconds
+void Host_runFor(uint32_t ms);
+
+// Draws a frame if anything is dirty, as the watch does after each event
+void Host_render();
+
+// Button presses on the top window: a single click, or count clicks in a row
+void Host_press(ButtonId button);
+void Host_multiPress(ButtonId button, uint8_t count);
+
+// Selects a row of the menu of the top window and clicks it
+bool Host_menuSelect(uint16_t section, uint16_t row);
+
+Window * Host_topWindow();
+int Host_windowCount();
+
+// Delivers accelerometer samples to the subscribed handler
+void Host_feedAccel(AccelData * samples, uint32_t count);
+
+// worker state, as app_worker_is_running() reports it
+void Host_setWorkerRunning(bool running);
+
+// The persisted storage, to launch the app again in a fresh process
+size_t Host_savePersist(void * buffer, size_t size);
+void Host_loadPersist(const void * buffer, size_t size);
+
+//
+// AppMessage loopback. Every frame the app sends is handed to the outbox
+// handler after the given latency; the handler decides its fate. Frames to
+// the app are built with Host_dictBegin() and delivered after the latency.
+
+typedef enum {
+    HOST_DELIVER,  // the phone gets it, the outbox is free again
+    HOST_NACK,     // the phone rejects it, outbox_failed is called
+    HOST_DROP,     // lost on the way, outbox_failed is called after a timeout
+} HostDelivery;
+
+typedef HostDelivery (*HostOutboxHandler)(DictionaryIterator * iter);
+
+void Host_setOutboxHandler(HostOutboxHandler handler, uint32_t latencyMs);
+void Host_setConnected(bool connected);
+
+// Builds a frame to the app and delivers it after the latency; a dropped one
+// never arrives.
+DictionaryIterator * Host_dictBegin();
+void Host_dictSend(bool dropped);
@@ -0,0 +1,398 @@
+#pragma once
+
+// Stand-in for the SDK's pebble.h, so the app's sources build and run on the
+// host. Only what the app uses is declared. Windows, layers, timers, persist
+// and AppMessage are simulated in host.c on a virtual clock; the calls that
+// cost battery or heap on the watch are counted, see host.h.
+//
+// Builds for basalt by default, -DHOST_PLATFORM_APLITE for aplite.
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HOST_PLATFORM_APLITE
+#define PBL_PLATFORM_APLITE
+#define PBL_BW
+#define PBL_IF_COLOR_ELSE(color, bw) (bw)
+#else
+#define PBL_PLATFORM_BASALT
+#define PBL_COLOR
+#define PBL_IF_COLOR_ELSE(color, bw) (color)
+#endif
+
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+
+//
+// heap and time, routed through the counters of host.c
+
+void * Host_malloc(size_t size);
+void * Host_calloc(size_t count, size_t size);
+void * Host_realloc(void * pointer, size_t size);
+void   Host_free(void * pointer);
+time_t Host_time(time_t * seconds);
+
+#define malloc(size)          Host_malloc(size)
+#define calloc(count, size)   Host_calloc((count), (size))
+#define realloc(pointer, size) Host_realloc((pointer), (size))
+#define free(pointer)         Host_free(pointer)
+#define time(seconds)         Host_time(seconds)
+
+uint16_t time_ms(time_t * seconds, uint16_t * ms);
+size_t heap_bytes_used(void);
+size_t heap_bytes_free(void);
+
+//
+// logging
+
+#define APP_LOG_LEVEL_ERROR   1
+#define APP_LOG_LEVEL_WARNING 50
+#define APP_LOG_LEVEL_INFO    100
+#define APP_LOG_LEVEL_DEBUG   200
+
+void Host_log(int level, const char * file, int line, const char * format, ...);
+#define APP_LOG(level, ...) Host_log((level), __FILE__, __LINE__, __VA_ARGS__)
+
+//
+// graphics
+
+typedef union {
+    uint8_t argb;
+    struct {
+        uint8_t b:2;
+        uint8_t g:2;
+        uint8_t r:2;
+        uint8_t a:2;
+    };
+} GColor8;
+typedef GColor8 GColor;
+
+#define GColorClear ((GColor8){ .argb = 0x00 })
+#define GColorBlack ((GColor8){ .argb = 0xc0 })
+#define GColorWhite ((GColor8){ .argb = 0xff })
+#define GColorRed   ((GColor8){ .argb = 0xf0 })
+#define GColorFromRGB(red, green, blue) \
+    ((GColor8){ .a = 3, .r = (uint8_t)(red) >> 6, .g = (uint8_t)(green) >> 6, .b = (uint8_t)(blue) >> 6 })
+
+typedef struct { int16_t x; int16_t y; } GPoint;
+typedef struct { int16_t w; int16_t h; } GSize;
+typedef struct { GPoint origin; GSize size; } GRect;
+
+#define GPoint(x, y)          ((GPoint){ (x), (y) })
+#define GSize(w, h)           ((GSize){ (w), (h) })
+#define GRect(x, y, w, h)     ((GRect){ { (x), (y) }, { (w), (h) } })
+
+typedef enum {
+    GBitmapFormat1Bit,
+    GBitmapFormat8Bit,
+    GBitmapFormat1BitPalette,
+    GBitmapFormat2BitPalette,
+    GBitmapFormat4BitPalette,
+} GBitmapFormat;
+
+typedef struct GBitmap GBitmap;
+typedef struct GContext GContext;
+typedef struct GFont * GFont;
+
+GBitmap * gbitmap_create_with_resource(uint32_t resource_id);
+GBitmap * gbitmap_create_as_sub_bitmap(const GBitmap * base_bitmap, GRect sub_rect);
+void gbitmap_destroy(GBitmap * bitmap);
+GColor * gbitmap_get_palette(const GBitmap * bitmap);
+GRect gbitmap_get_bounds(const GBitmap * bitmap);
+uint16_t gbitmap_get_bytes_per_row(const GBitmap * bitmap);
+GBitmapFormat gbitmap_get_format(const GBitmap * bitmap);
+
+#define FONT_KEY_GOTHIC_18_BOLD "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_GOTHIC_24_BOLD "RESOURCE_ID_GOTHIC_24_BOLD"
+GFont fonts_get_system_font(const char * font_key);
+
+// resources of appinfo.json
+#define RESOURCE_ID_IMAGE_ACTION_ICON_UP    1
+#define RESOURCE_ID_IMAGE_ACTION_ICON_OK    2
+#define RESOURCE_ID_IMAGE_ACTION_ICON_NOK   3
+#define RESOURCE_ID_IMAGE_ACTION_ICON_DOWN  4
+#define RESOURCE_ID_IMAGE_ACTION_ICON_PLAY  5
+#define RESOURCE_ID_IMAGE_ACTION_ICON_PAUSE 6
+#define RESOURCE_ID_CLOCK_DIGIT_ATLAS       7
+#define RESOURCE_ID_CLOCK_DIGIT_BOLD_ATLAS  8
+
+//
+// layers and windows
+
+typedef struct Layer Layer;
+typedef struct BitmapLayer BitmapLayer;
+typedef struct TextLayer TextLayer;
+typedef struct MenuLayer MenuLayer;
+typedef struct ActionBarLayer ActionBarLayer;
+typedef struct Window Window;
+
+void layer_mark_dirty(Layer * layer);
+void layer_add_child(Layer * parent, Layer * child);
+void layer_set_hidden(Layer * layer, bool hidden);
+bool layer_get_hidden(const Layer * layer);
+void layer_set_frame(Layer * layer, GRect frame);
+GRect layer_get_frame(const Layer * layer);
+GRect layer_get_bounds(const Layer * layer);
+
+BitmapLayer * bitmap_layer_create(GRect frame);
+void bitmap_layer_destroy(BitmapLayer * bitmap_layer);
+Layer * bitmap_layer_get_layer(const BitmapLayer * bitmap_layer);
+void bitmap_layer_set_bitmap(BitmapLayer * bitmap_layer, const GBitmap * bitmap);
+
+typedef enum { GTextAlignmentLeft, GTextAlignmentCenter, GTextAlignmentRight } GTextAlignment;
+
+TextLayer * text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer * text_layer);
+Layer * text_layer_get_layer(TextLayer * text_layer);
+void text_layer_set_text(TextLayer * text_layer, const char * text);
+void text_layer_set_background_color(TextLayer * text_layer, GColor color);
+void text_layer_set_text_alignment(TextLayer * text_layer, GTextAlignment text_alignment);
+void text_layer_set_font(TextLayer * text_layer, GFont font);
+GSize text_layer_get_content_size(TextLayer * text_layer);
+
+typedef enum { BUTTON_ID_BACK, BUTTON_ID_UP, BUTTON_ID_SELECT, BUTTON_ID_DOWN, NUM_BUTTONS } ButtonId;
+
+typedef void * ClickRecognizerRef;
+typedef void (*ClickHandler)(ClickRecognizerRef recognizer, void * context);
+typedef void (*ClickConfigProvider)(void * context);
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler);
+void window_single_repeating_click_subscribe(ButtonId button_id, uint16_t repeat_interval_ms, ClickHandler handler);
+void window_multi_click_subscribe(ButtonId button_id, uint8_t min_clicks, uint8_t max_clicks, uint16_t timeout,
+                                  bool last_click_only, ClickHandler handler);
+
+typedef void (*WindowHandler)(Window * window);
+typedef struct {
+    WindowHandler load;
+    WindowHandler appear;
+    WindowHandler disappear;
+    WindowHandler unload;
+} WindowHandlers;
+
+Window * window_create(void);
+void window_destroy(Window * window);
+void window_set_window_handlers(Window * window, WindowHandlers handlers);
+void window_set_background_color(Window * window, GColor background_color);
+Layer * window_get_root_layer(const Window * window);
+void window_set_click_config_provider(Window * window, ClickConfigProvider click_config_provider);
+void window_set_click_config_provider_with_context(Window * window, ClickConfigProvider click_config_provider,
+                                                   void * context);
+ClickConfigProvider window_get_click_config_provider(const Window * window);
+void * window_get_click_config_context(Window * window);
+
+void window_stack_push(Window * window, bool animated);
+Window * window_stack_pop(bool animated);
+void window_stack_pop_all(bool animated);
+bool window_stack_contains_window(Window * window);
+Window * window_stack_get_top_window(void);
+
+#define ACTION_BAR_WIDTH 30
+
+ActionBarLayer * action_bar_layer_create(void);
+void action_bar_layer_destroy(ActionBarLayer * action_bar);
+void action_bar_layer_add_to_window(ActionBarLayer * action_bar, Window * window);
+void action_bar_layer_remove_from_window(ActionBarLayer * action_bar);
+void action_bar_layer_set_click_config_provider(ActionBarLayer * action_bar, ClickConfigProvider click_config_provider);
+void action_bar_layer_set_icon(ActionBarLayer * action_bar, ButtonId button_id, const GBitmap * icon);
+void action_bar_layer_set_icon_animated(ActionBarLayer * action_bar, ButtonId button_id, const GBitmap * icon,
+                                        bool animated);
+
+typedef struct { uint16_t section; uint16_t row; } MenuIndex;
+
+typedef struct {
+    uint16_t (*get_num_sections)(MenuLayer * menu_layer, void * callback_context);
+    uint16_t (*get_num_rows)(MenuLayer * menu_layer, uint16_t section_index, void * callback_context);
+    int16_t  (*get_cell_height)(MenuLayer * menu_layer, MenuIndex * cell_index, void * callback_context);
+    int16_t  (*get_header_height)(MenuLayer * menu_layer, uint16_t section_index, void * callback_context);
+    void     (*draw_row)(GContext * ctx, const Layer * cell_layer, MenuIndex * cell_index, void * callback_context);
+    void     (*draw_header)(GContext * ctx, const Layer * cell_layer, uint16_t section_index, void * callback_context);
+    void     (*select_click)(MenuLayer * menu_layer, MenuIndex * cell_index, void * callback_context);
+} MenuLayerCallbacks;
+
+#define MENU_CELL_BASIC_HEADER_HEIGHT 16
+
+MenuLayer * menu_layer_create(GRect frame);
+void menu_layer_destroy(MenuLayer * menu_layer);
+Layer * menu_layer_get_layer(const MenuLayer * menu_layer);
+void menu_layer_set_callbacks(MenuLayer * menu_layer, void * callback_context, MenuLayerCallbacks callbacks);
+void menu_layer_set_click_config_onto_window(MenuLayer * menu_layer, Window * window);
+void menu_layer_reload_data(MenuLayer * menu_layer);
+void menu_cell_basic_draw(GContext * ctx, const Layer * cell_layer, const char * title, const char * subtitle,
+                          GBitmap * icon);
+void menu_cell_basic_header_draw(GContext * ctx, const Layer * cell_layer, const char * title);
+
+//
+// timers and services
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void * data);
+
+AppTimer * app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void * callback_data);
+bool app_timer_reschedule(AppTimer * timer, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer * timer);
+
+void app_event_loop(void);
+
+typedef struct {
+    const uint32_t * durations;
+    uint32_t num_segments;
+} VibePattern;
+
+void vibes_short_pulse(void);
+void vibes_long_pulse(void);
+void vibes_double_pulse(void);
+void vibes_enqueue_custom_pattern(VibePattern pattern);
+void vibes_cancel(void);
+
+typedef struct {
+    int16_t  x;
+    int16_t  y;
+    int16_t  z;
+    bool     did_vibrate;
+    uint64_t timestamp;
+} AccelData;
+
+typedef enum {
+    ACCEL_SAMPLING_10HZ  = 10,
+    ACCEL_SAMPLING_25HZ  = 25,
+    ACCEL_SAMPLING_50HZ  = 50,
+    ACCEL_SAMPLING_100HZ = 100,
+} AccelSamplingRate;
+
+typedef void (*AccelDataHandler)(AccelData * data, uint32_t num_samples);
+
+void accel_data_service_subscribe(uint32_t samples_per_update, AccelDataHandler handler);
+void accel_data_service_unsubscribe(void);
+int accel_service_set_sampling_rate(AccelSamplingRate rate);
+
+typedef struct {
+    void (*pebble_app_connection_handler)(bool connected);
+    void (*pebblekit_connection_handler)(bool connected);
+} ConnectionHandlers;
+
+void connection_service_subscribe(ConnectionHandlers handlers);
+void connection_service_unsubscribe(void);
+bool connection_service_peek_pebble_app_connection(void);
+
+//
+// persist
+
+typedef int32_t status_t;
+
+#define S_SUCCESS         0
+#define E_DOES_NOT_EXIST  (-10)
+#define E_OUT_OF_STORAGE  (-9)
+
+#define PERSIST_DATA_MAX_LENGTH   256
+#define PERSIST_STRING_MAX_LENGTH PERSIST_DATA_MAX_LENGTH
+
+bool persist_exists(uint32_t key);
+int persist_get_size(uint32_t key);
+int32_t persist_read_int(uint32_t key);
+int persist_read_data(uint32_t key, void * buffer, size_t buffer_size);
+status_t persist_write_int(uint32_t key, int32_t value);
+int persist_write_data(uint32_t key, const void * data, size_t size);
+status_t persist_delete(uint32_t key);
+
+//
+// background worker
+
+typedef struct {
+    uint16_t data0;
+    uint16_t data1;
+    uint16_t data2;
+} AppWorkerMessage;
+
+typedef enum {
+    APP_WORKER_RESULT_SUCCESS,
+    APP_WORKER_RESULT_NO_WORKER,
+    APP_WORKER_RESULT_DIFFERENT_APP,
+    APP_WORKER_RESULT_NOT_RUNNING,
+    APP_WORKER_RESULT_ALREADY_RUNNING,
+    APP_WORKER_RESULT_ASKING_CONFIRMATION,
+} AppWorkerResult;
+
+typedef void (*AppWorkerMessageHandler)(uint16_t type, AppWorkerMessage * data);
+
+bool app_worker_is_running(void);
+AppWorkerResult app_worker_launch(void);
+AppWorkerResult app_worker_kill(void);
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler);
+bool app_worker_message_unsubscribe(void);
+void app_worker_send_message(uint8_t type, AppWorkerMessage * data);
+
+//
+// AppMessage
+
+typedef enum {
+    TUPLE_BYTE_ARRAY = 0,
+    TUPLE_CSTRING    = 1,
+    TUPLE_UINT       = 2,
+    TUPLE_INT        = 3,
+} TupleType;
+
+typedef struct __attribute__((__packed__)) {
+    uint32_t key;
+    TupleType type:8;
+    uint16_t length;
+    union {
+        uint8_t  data[0];
+        char     cstring[0];
+        uint8_t  uint8;
+        uint16_t uint16;
+        uint32_t uint32;
+        int8_t   int8;
+        int16_t  int16;
+        int32_t  int32;
+    } value[];
+} Tuple;
+
+typedef struct {
+    uint8_t * begin;  // the count of tuples, then the tuples
+    uint8_t * end;    // end of the buffer
+    uint8_t * cursor; // next tuple to write or read
+} DictionaryIterator;
+
+typedef enum {
+    DICT_OK                = 0,
+    DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+    DICT_INVALID_ARGS      = 1 << 2,
+} DictionaryResult;
+
+DictionaryResult dict_write_int32(DictionaryIterator * iter, uint32_t key, int32_t value);
+DictionaryResult dict_write_uint32(DictionaryIterator * iter, uint32_t key, uint32_t value);
+DictionaryResult dict_write_data(DictionaryIterator * iter, uint32_t key, const uint8_t * data, uint16_t size);
+uint32_t dict_write_end(DictionaryIterator * iter);
+Tuple * dict_find(const DictionaryIterator * iter, uint32_t key);
+uint32_t dict_calc_buffer_size(uint8_t tuple_count, ...);
+
+typedef enum {
+    APP_MSG_OK                  = 0,
+    APP_MSG_SEND_TIMEOUT        = 1 << 1,
+    APP_MSG_SEND_REJECTED       = 1 << 2,
+    APP_MSG_NOT_CONNECTED       = 1 << 3,
+    APP_MSG_BUSY                = 1 << 6,
+    APP_MSG_BUFFER_OVERFLOW     = 1 << 7,
+    APP_MSG_CLOSED              = 1 << 11,
+} AppMessageResult;
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator * iterator, void * context);
+typedef void (*AppMessageInboxDropped)(AppMessageResult reason, void * context);
+typedef void (*AppMessageOutboxSent)(DictionaryIterator * iterator, void * context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator * iterator, AppMessageResult reason, void * context);
+
+AppMessageResult app_message_open(uint32_t size_inbound, uint32_t size_outbound);
+uint32_t app_message_inbox_size_maximum(void);
+uint32_t app_message_outbox_size_maximum(void);
+AppMessageResult app_message_outbox_begin(DictionaryIterator ** iterator);
+AppMessageResult app_message_outbox_send(void);
+void app_message_register_inbox_received(AppMessageInboxReceived received_callback);
+void app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback);
+void app_message_register_outbox_sent(AppMessageOutboxSent sent_callback);
+void app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback);
+void app_message_deregister_callbacks(void);
@@ -0,0 +1,190 @@
+// Round trips LaneSplits through its encoding and times encoding and decoding
+// a full recorder. Exits with 1 if a round trip doesn't give back the splits.
+
+#include "host.h"
+#include "lane_splits.h"
+
+#ifdef HOST_PLATFORM_APLITE
+#define PLATFORM_NAME "aplite"
+#else
+#define PLATFORM_NAME "basalt"
+#endif
+
+// what the app stores the splits in, see NUM_SPLITS_PERSIST_KEYS
+#define STORED_SIZE (2 * PERSIST_DATA_MAX_LENGTH)
+
+static int failures = 0;
+
+#define CHECK(condition, ...) \
+    do { if (!(condition)) { printf("  FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); ++failures; } } while (0)
+
+static bool sameSplits(const LaneSplits * a, const LaneSplits * b)
+{
+    if (a->count != b->count) return false;
+    for (uint16_t i = 0; i < a->count; ++i) {
+        const LaneSplit * x = &a->records[i];
+        const LaneSplit * y = &b->records[i];
+        if (x->splitTime != y->splitTime || x->pauseTime != y->pauseTime ||
+            x->laneSpan != y->laneSpan || x->flags != y->flags) return false;
+    }
+    return true;
+}
+
+static int roundTrip(const char * name, const LaneSplits * splits, int target)
+{
+    static uint8_t buffer[8 * 1024];
+    static LaneSplits decoded;
+
+    const int size = LaneSplits_encode(splits, target, buffer, sizeof(buffer));
+    CHECK(size > 0, "%s: encoding failed", name);
+    if (size <= 0) return size;
+
+    CHECK(LaneSplits_decode(&decoded, buffer, size), "%s: decoding failed", name);
+    CHECK(sameSplits(splits, &decoded), "%s: %d records in, %d out or different", name, splits->count, decoded.count);
+    return size;
+}
+
+// a lane of swimming at the target, give or take a few seconds
+static int laneTime(int target, int lane)
+{
+    return target + (lane * 37) % 61 - 30;
+}
+
+static void testRoundTrips()
+{
+    static LaneSplits splits;
+    const int target = 360;
+
+    // plain lanes near the target take a byte each
+    LaneSplits_reset(&splits);
+    for (int lane = 0; lane < 40; ++lane) LaneSplits_append(&splits, laneTime(target, lane), 0, 0);
+    const int size = roundTrip("plain lanes", &splits, target);
+    CHECK(size <= 3 + 40, "plain lanes: %d bytes for 40 lanes", size);
+
+    // pauses, restarts and lanes far off the target need escape codes
+    LaneSplits_reset(&splits);
+    LaneSplits_append(&splits, target, 1200, 0);
+    LaneSplits_append(&splits, 80, 0, LANE_SPLIT_FLAG_RESTART);
+    LaneSplits_append(&splits, 3000, 0, 0);
+    LaneSplits_append(&splits, 0, 0, 0);
+    LaneSplits_append(&splits, 0xffff, 0xffff, LANE_SPLIT_FLAG_RESTART);
+    LaneSplits_append(&splits, target - 124, 0, 0);
+    LaneSplits_append(&splits, target + 127, 0, 0);
+    roundTrip("escapes", &splits, target);
+
+    // a target of 0, as after a workout without lanes
+    roundTrip("no target", &splits, 0);
+    LaneSplits_reset(&splits);
+    roundTrip("no lanes", &splits, target);
+
+    // more lanes than the recorder holds are merged into spans
+    LaneSplits_reset(&splits);
+    int restarts = 0;
+    for (int lane = 0; lane < 20 * LANE_SPLITS_CAPACITY; ++lane) {
+        const bool restart = lane % 17 == 5;
+        LaneSplits_append(&splits, restart ? 50 : laneTime(target, lane), lane % 50 == 0 ? 300 : 0,
+                          restart ? LANE_SPLIT_FLAG_RESTART : 0);
+        restarts += restart;
+    }
+    roundTrip("merged lanes", &splits, target);
+
+    // a restart never merges with a swum lane
+    int spanned = 0;
+    int lastSpan = 0;
+    for (uint16_t i = 0; i < splits.count; ++i) {
+        spanned += splits.records[i].laneSpan;
+        lastSpan = splits.records[i].laneSpan;
+    }
+    CHECK(splits.count <= LANE_SPLITS_CAPACITY, "merged lanes: %d records", splits.count);
+    CHECK(lastSpan == 1, "merged lanes: the newest record spans %d lanes", lastSpan);
+    CHECK(spanned <= 20 * LANE_SPLITS_CAPACITY, "merged lanes: %d lanes spanned", spanned);
+
+    // long lanes and pauses are kept apart rather than merged into a clamped time
+    LaneSplits_reset(&splits);
+    for (int lane = 0; lane < 3 * LANE_SPLITS_CAPACITY; ++lane) {
+        const int splitTime = lane % 3 ? 40000 : laneTime(target, lane);
+        const int pauseTime = lane % 5 ? 0 : 50000;
+        LaneSplits_append(&splits, splitTime, pauseTime, 0);
+    }
+    for (uint16_t i = 0; i < splits.count; ++i) {
+        CHECK(splits.records[i].splitTime < 0xffff && splits.records[i].pauseTime < 0xffff,
+              "long lanes: record %d clamped", i);
+    }
+    roundTrip("long lanes", &splits, target);
+}
+
+static void testDecoding()
+{
+    static LaneSplits splits;
+
+    // version 1 stored seconds
+    const uint8_t seconds[] = { 1, 36, 2, 0x81, 10, 0xfe };
+    CHECK(LaneSplits_decode(&splits, seconds, sizeof(seconds)), "version 1 not decoded");
+    CHECK(splits.count == 2 && splits.records[0].splitTime == 380 && splits.records[1].pauseTime == 100 &&
+          splits.records[1].splitTime == 340, "version 1 decoded wrong");
+
+    const uint8_t version[] = { 9, 36, 0 };
+    CHECK(!LaneSplits_decode(&splits, version, sizeof(version)), "unknown version decoded");
+
+    const uint8_t truncated[] = { 2, 0xe8, 0x82, 0x80, 0x96 };
+    CHECK(!LaneSplits_decode(&splits, truncated, sizeof(truncated)), "truncated varint decoded");
+
+    const uint8_t zeroSpan[] = { 2, 36, 0x83, 0, 0 };
+    CHECK(!LaneSplits_decode(&splits, zeroSpan, sizeof(zeroSpan)), "span of 0 decoded");
+
+    CHECK(!LaneSplits_decode(&splits, NULL, 0), "empty buffer decoded");
+}
+
+//
+// benchmark
+
+static double seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void benchmark()
+{
+    static LaneSplits splits;
+    static LaneSplits decoded;
+    static uint8_t buffer[STORED_SIZE];
+    const int target = 360;
+
+    // a full recorder of plain lanes with a pause now and then, as stored after a long workout
+    LaneSplits_reset(&splits);
+    for (int lane = 0; lane < LANE_SPLITS_CAPACITY; ++lane) {
+        LaneSplits_append(&splits, laneTime(target, lane), lane % 25 == 24 ? 600 : 0, 0);
+    }
+
+    const int iterations = 20000;
+    int size = 0;
+    double start = seconds();
+    for (int i = 0; i < iterations; ++i) size = LaneSplits_encode(&splits, target, buffer, sizeof(buffer));
+    const double encodeSeconds = seconds() - start;
+
+    start = seconds();
+    for (int i = 0; i < iterations; ++i) LaneSplits_decode(&decoded, buffer, size);
+    const double decodeSeconds = seconds() - start;
+
+    CHECK(size > 0 && sameSplits(&splits, &decoded), "benchmark round trip");
+
+    const double lanes = (double)iterations * splits.count;
+    printf("  %d lanes in %d bytes (%.2f per lane) of %d stored; raw records take %d\n",
+           splits.count, size, size / (double)splits.count, STORED_SIZE, (int)(splits.count * sizeof(LaneSplit)));
+    printf("  encode %.1f ns per lane, decode %.1f ns per lane (on this computer)\n",
+           encodeSeconds / lanes * 1e9, decodeSeconds / lanes * 1e9);
+}
+
+int main(void)
+{
+    printf("== lane splits on %s, capacity %d\n", PLATFORM_NAME, LANE_SPLITS_CAPACITY);
+
+    testRoundTrips();
+    testDecoding();
+    benchmark();
+
+    printf("  %s\n", failures ? "FAILED" : "round trips ok");
+    return failures ? 1 : 0;
+}
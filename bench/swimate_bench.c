@@ -0,0 +1,313 @@
+// Runs the app on the simulated watch of host/ and reports what a launch and a
+// workout cost: bitmap loads, redraws, persist traffic, vibes, wakeups and heap.
+//
+//   swimate_bench [lanes] [seconds per lane]
+//
+// Each launch runs in its own process, as the app's statics only start out
+// clean once; the persisted storage is handed from one launch to the next.
+// Exits with 1 if a workout the app was closed in doesn't keep its lanes, if
+// the first frame isn't drawn before the deferred part of the startup, or if
+// heap is still allocated when the app exits.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "clock_digit.h"
+#include "history.h"
+#include "perf_counters.h"
+#include "workout_stats.h"
+
+#ifdef HOST_PLATFORM_APLITE
+#define PLATFORM_NAME "aplite"
+#else
+#define PLATFORM_NAME "basalt"
+#endif
+
+#define START_TIME 1700000000
+
+// keys and menu rows of swimate.c
+#define PERSIST_KEY_DESIRED_LANE_COUNT 0
+#define PERSIST_KEY_TIME_PER_LANE      1
+#define PERSIST_KEY_LAST_WORKOUT_STATS 12
+#define MENU_ROW_START   0, 3
+#define MENU_ROW_SUMMARY 1, 0
+
+int swimate_main(void);
+
+static int lanes = 40;
+static int secondsPerLane = 30;
+static HostCounters startup;
+static int failures = 0;
+
+// rough times of a watch, charged on the virtual clock until the startup is done
+static const HostCosts startupCosts = {
+    .persistReadMs = 1, .persistWriteMs = 4, .bitmapLoadMs = 6, .frameMs = 12,
+};
+
+static void report(const char * title, const HostCounters * counters, double seconds)
+{
+    printf("%s\n", title);
+    printf("  bitmap loads        %6u\n", counters->bitmapLoads);
+    printf("  sub bitmaps         %6u\n", counters->subBitmaps);
+    printf("  layer_mark_dirty    %6u\n", counters->markDirty);
+    printf("  frames              %6u\n", counters->frames);
+    printf("  menu rows drawn     %6u\n", counters->rowsDrawn);
+    printf("  persist reads       %6u\n", counters->persistReads);
+    printf("  persist writes      %6u (%u bytes)\n", counters->persistWrites, counters->persistBytesWritten);
+    printf("  vibes               %6u (%u ms)\n", counters->vibes, counters->vibeMs);
+    printf("  timer wakeups       %6u\n", counters->timerWakeups);
+    printf("  worker messages     %6u\n", counters->workerMessages);
+    printf("  window pushes       %6u\n", counters->windowPushes);
+    printf("  allocations         %6u (%u freed)\n", counters->allocs, counters->frees);
+    printf("  heap used / peak    %6u / %u bytes\n", (unsigned)counters->heapUsed, (unsigned)counters->heapPeak);
+    if (seconds <= 0) return;
+
+    printf("  per second: %.2f wakeups, %.2f frames, %.2f layer_mark_dirty, %.1f vibe ms\n",
+           counters->timerWakeups / seconds, counters->frames / seconds, counters->markDirty / seconds,
+           counters->vibeMs / seconds);
+}
+
+// what the app counted itself since it was launched, times on the virtual clock
+static void reportPerfCounters(const char * title)
+{
+    printf("%s\n", title);
+    for (int i = 0; i < NUM_PERF_COUNTERS; ++i) {
+        printf("  %-19s %6u\n", PerfCounters_name(i), (unsigned)PerfCounters_get(i));
+    }
+    printf("  heap high-water     %6u bytes\n", (unsigned)PerfCounters_heapHighWater());
+}
+
+// The startup until the event loop, with the first frame, then its deferred
+// part. The first frame has to be on the screen before the deferred part runs.
+static void runStartup(const char * title)
+{
+    startup = hostCounters;
+    Host_resetCounters();
+    Host_runFor(100);
+    Host_setCosts(NULL);
+    if (!title) return;
+
+    report(title, &startup, 0);
+    report("deferred startup", &hostCounters, 0);
+
+    const uint32_t firstFrameMs = PerfCounters_get(PERF_FIRST_FRAME_MS);
+    printf("  first frame after %u ms, %u ms of startup deferred\n", (unsigned)firstFrameMs,
+           (unsigned)hostCounters.busyMs);
+    if (firstFrameMs == 0 || firstFrameMs > startup.busyMs || hostCounters.busyMs == 0) {
+        printf("  FAIL the first frame waits for the deferred startup\n");
+        ++failures;
+    }
+}
+
+//
+// first launch: a fresh install, one workout
+
+// The swimmer taps at the wall a little before the deadline, mostly. The
+// target of a lane is the time of the previous one, so the pace creeps up; now
+// and then a lane runs into its deadline and the app starts the next one on its
+// own. Halfway there is a break, and one lane is restarted before its end.
+static void swimWorkout()
+{
+    int32_t targetMs = secondsPerLane * 1000;
+    for (int lane = 0; lane < lanes; ++lane) {
+        if (lane == lanes / 2) {
+            Host_press(BUTTON_ID_SELECT);
+            Host_runFor(20000);
+            Host_press(BUTTON_ID_SELECT);
+        }
+        if (lane == 5) {
+            targetMs -= 1000;
+            Host_runFor(targetMs);
+            Host_multiPress(BUTTON_ID_DOWN, 2);
+        }
+
+        if (lane % 7 == 3) {
+            Host_runFor(targetMs);
+        } else {
+            targetMs -= 50 + 61 * (lane % 5);
+            Host_runFor(targetMs);
+            Host_press(BUTTON_ID_DOWN);
+        }
+    }
+    Host_runFor(1000);
+}
+
+static void firstLaunch()
+{
+    runStartup("startup until the first frame");
+
+    Host_resetCounters();
+    Host_menuSelect(MENU_ROW_START);
+    const int64_t start = Host_now();
+    swimWorkout();
+
+    // finish: back, and OK in the prompt
+    Host_press(BUTTON_ID_BACK);
+    Host_press(BUTTON_ID_UP);
+    const double seconds = (Host_now() - start) / 1000.0;
+
+    char title[64];
+    snprintf(title, sizeof(title), "workout of %d lanes, %.0f s", lanes, seconds);
+    report(title, &hostCounters, seconds);
+    printf("  digit redraws       %6u\n", (unsigned)ClockDigit_getRedrawCount());
+    printf("  per lane: %.1f frames, %.1f persist writes, %.1f wakeups\n",
+           hostCounters.frames / (double)lanes, hostCounters.persistWrites / (double)lanes,
+           hostCounters.timerWakeups / (double)lanes);
+
+    // the summary, then quit the app
+    Host_press(BUTTON_ID_BACK);
+    Host_press(BUTTON_ID_BACK);
+    Host_press(BUTTON_ID_UP);
+    reportPerfCounters("perf counters of the app");
+}
+
+//
+// second launch: the last workout is looked at
+
+static void secondLaunch()
+{
+    runStartup("startup with a workout in the history");
+
+    Host_resetCounters();
+    Host_menuSelect(MENU_ROW_SUMMARY);
+    report("opening the summary", &hostCounters, 0);
+
+    Host_press(BUTTON_ID_BACK);
+    Host_press(BUTTON_ID_BACK);
+    Host_press(BUTTON_ID_UP);
+    reportPerfCounters("perf counters of the app");
+}
+
+//
+// a workout the app is closed in: half of it, then the worker runs three
+// lanes on its own, then the app is opened again for the rest
+
+#define CLOSED_LANES 3
+
+// each lane a little faster than the one before, so every tap beats the target
+static int32_t laneMs(int lane)
+{
+    return 20000 - 100 * lane;
+}
+
+static void closeDuringWorkout()
+{
+    runStartup(NULL);
+    Host_menuSelect(MENU_ROW_START);
+    for (int lane = 0; lane < lanes / 2; ++lane) {
+        Host_runFor(laneMs(lane));
+        Host_press(BUTTON_ID_DOWN);
+    }
+}
+
+// opened within a second after the worker started the next lane
+static time_t reopenTime(time_t closeLaunch)
+{
+    int64_t ms = 100;
+    for (int lane = 0; lane < lanes / 2; ++lane) ms += laneMs(lane);
+    ms += CLOSED_LANES * laneMs(lanes / 2 - 1);
+    return closeLaunch + ms / 1000 + 1;
+}
+
+static void resumeWorkout()
+{
+    runStartup(NULL);
+
+    // the last lane ends with the workout
+    for (int lane = lanes / 2 + CLOSED_LANES; lane < lanes; ++lane) {
+        Host_runFor(laneMs(lane) - 1000);
+        if (lane < lanes - 1) Host_press(BUTTON_ID_DOWN);
+    }
+    Host_press(BUTTON_ID_BACK);
+    Host_press(BUTTON_ID_UP);
+
+    HistoryRecord record = { 0 };
+    WorkoutStats stats = { 0 };
+    History_get(0, &record);
+    persist_read_data(PERSIST_KEY_LAST_WORKOUT_STATS, &stats, sizeof(stats));
+    printf("workout closed after %d lanes for %d\n  %d lanes, %d of them in the statistics\n", lanes / 2,
+           CLOSED_LANES, record.laneCount, stats.laneCount);
+    if (record.laneCount != lanes || stats.laneCount != lanes) {
+        printf("  FAIL the lanes before the app was opened again are lost\n");
+        ++failures;
+    }
+
+    Host_press(BUTTON_ID_BACK);
+    Host_press(BUTTON_ID_BACK);
+    Host_press(BUTTON_ID_UP);
+}
+
+static void launch(void (*eventLoop)(), time_t startTime, const void * persist, size_t persistSize)
+{
+    Host_reset(startTime);
+    Host_loadPersist(persist, persistSize);
+    if (!persist) {
+        persist_write_int(PERSIST_KEY_DESIRED_LANE_COUNT, lanes);
+        persist_write_int(PERSIST_KEY_TIME_PER_LANE, secondsPerLane);
+        Host_resetCounters();
+    }
+    Host_setEventLoop(eventLoop);
+    Host_setCosts(&startupCosts);
+
+    swimate_main();
+
+    if (Host_windowCount() != 0) printf("  error: %d windows left on the stack\n", Host_windowCount());
+    printf("  heap still allocated at exit %u bytes\n", (unsigned)hostCounters.heapUsed);
+    if (hostCounters.heapUsed != 0) {
+        printf("  FAIL the app doesn't free its heap at exit\n");
+        ++failures;
+    }
+}
+
+// runs a launch in a process of its own, persist goes in and comes back
+static bool launchProcess(void (*eventLoop)(), time_t startTime, uint8_t * persist, size_t * size, size_t capacity)
+{
+    fflush(stdout);
+    int channel[2];
+    if (pipe(channel) != 0) return false;
+
+    const pid_t child = fork();
+    if (child == 0) {
+        close(channel[0]);
+        launch(eventLoop, startTime, *size ? persist : NULL, *size);
+        const size_t saved = Host_savePersist(persist, capacity);
+        if (write(channel[1], persist, saved) != (ssize_t)saved) _exit(1);
+        fflush(stdout);
+        _exit(failures ? 1 : 0);
+    }
+    close(channel[1]);
+
+    *size = 0;
+    ssize_t n;
+    while ((n = read(channel[0], persist + *size, capacity - *size)) > 0) *size += n;
+    close(channel[0]);
+
+    int status;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc > 1) lanes = atoi(argv[1]);
+    if (argc > 2) secondsPerLane = atoi(argv[2]);
+    if (lanes < 1 || secondsPerLane < 5) {
+        fprintf(stderr, "usage: %s [lanes] [seconds per lane >= 5]\n", argv[0]);
+        return 2;
+    }
+
+    printf("== swimate on %s, %d lanes of %d s\n", PLATFORM_NAME, lanes, secondsPerLane);
+
+    static uint8_t persist[32 * 1024];
+    size_t size = 0;
+    if (!launchProcess(firstLaunch, START_TIME, persist, &size, sizeof(persist))) return 1;
+
+    if (!launchProcess(secondLaunch, START_TIME, persist, &size, sizeof(persist))) return 1;
+
+    // a fresh install, closed in the middle of a workout
+    if (lanes / 2 + CLOSED_LANES >= lanes || laneMs(lanes) < 5000 || laneMs(0) > secondsPerLane * 1000) return 0;
+    size = 0;
+    if (!launchProcess(closeDuringWorkout, START_TIME, persist, &size, sizeof(persist))) return 1;
+    return launchProcess(resumeWorkout, reopenTime(START_TIME), persist, &size, sizeof(persist)) ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+// Syncs the history to a phone over the AppMessage loopback of host/ and checks
+// that the phone ends up with every workout and the latest splits, also when
+// frames are dropped or rejected and the link goes away. Reports the
+// throughput in records per second of the virtual clock.
+//
+//   sync_loopback [seed] [lossy runs]
+//
+// The phone does what src/js/app.js does. Exits with 1 if in any run the phone
+// didn't get everything in.
+
+#include "host.h"
+#include "history.h"
+#include "sync.h"
+
+#define START_TIME   1700000000
+#define WORKOUTS     70 // more than the history holds, the oldest are dropped
+#define SPLITS_SIZE  200
+#define LATENCY_MS   50
+#define RUN_MS       (10 * 60 * 1000)
+#define STEP_MS      100
+#define RECONNECT_MS (60 * 1000)      // the phone is back after a lost link
+#define REQUEST_MS   (2 * 60 * 1000)  // the phone asks again, as when the app is opened
+
+typedef struct {
+    int dropPercent;       // frames of the watch lost on the way
+    int nackPercent;       // frames of the watch the phone rejects
+    int replyDropPercent;  // frames of the phone lost on the way
+    int lostAcks;          // the first acks of the phone that get lost
+    bool duplicateAcks;    // every records ack is sent twice
+    int lostSplitsFrames;  // the first splits frames that get lost
+    bool cutAfterRecords;  // the link goes away once the last records arrived
+} Faults;
+
+typedef struct {
+    Faults faults;
+    bool linkDown;
+    int32_t ackedId;
+    int32_t splitsId;
+    bool stored[0x10000];
+    bool splitsOk;
+    bool done;
+    int requests;
+    uint32_t randomState;
+} Phone;
+
+static Phone phone;
+static uint8_t persist[32 * 1024];
+static size_t persistSize;
+static int failures = 0;
+
+static bool chance(int percent)
+{
+    phone.randomState = phone.randomState * 1103515245 + 12345;
+    return (int)((phone.randomState >> 8) % 100) < percent;
+}
+
+//
+// the watch
+
+static HistoryRecord workoutRecord(int i)
+{
+    return (HistoryRecord){
+        .startTime    = START_TIME + i * 3600,
+        .endTime      = START_TIME + i * 3600 + 1800,
+        .pauseTime    = i % 7,
+        .laneCount    = 20 + i,
+        .lengthOfLane = 25,
+    };
+}
+
+static int readSplits(uint8_t * buffer, size_t size)
+{
+    if (size < SPLITS_SIZE) return 0;
+    for (int i = 0; i < SPLITS_SIZE; ++i) buffer[i] = (uint8_t)(i * 7 + History_id(0));
+    return SPLITS_SIZE;
+}
+
+//
+// the phone
+
+static void reply(uint8_t command, int32_t id)
+{
+    DictionaryIterator * iter = Host_dictBegin();
+    dict_write_int32(iter, SYNC_KEY_COMMAND, command);
+    dict_write_int32(iter, SYNC_KEY_ID, id);
+    if (command == SYNC_CMD_REQUEST) dict_write_int32(iter, SYNC_KEY_SPLITS_ID, phone.splitsId);
+    dict_write_end(iter);
+
+    bool lost = phone.linkDown || chance(phone.faults.replyDropPercent);
+    if (command != SYNC_CMD_REQUEST && phone.faults.lostAcks > 0) {
+        --phone.faults.lostAcks;
+        lost = true;
+    }
+    Host_dictSend(lost);
+}
+
+static void request()
+{
+    ++phone.requests;
+    phone.done = false;
+    reply(SYNC_CMD_REQUEST, phone.ackedId);
+}
+
+static void onRecords(int32_t firstId, int32_t count, const Tuple * payload)
+{
+    if (!payload || payload->length != count * sizeof(HistoryRecord)) {
+        printf("  FAIL records frame of %d records has %d bytes\n", (int)count, payload ? payload->length : 0);
+        ++failures;
+        return;
+    }
+
+    const HistoryRecord * records = (const HistoryRecord *)payload->value->data;
+    for (int i = 0; i < count; ++i) {
+        const uint16_t id = firstId + i;
+        HistoryRecord expected = { 0 };
+        History_get((uint16_t)(History_id(0) - id), &expected);
+        if (memcmp(&records[i], &expected, sizeof(expected)) != 0) {
+            printf("  FAIL workout %d arrived different\n", id);
+            ++failures;
+        }
+        phone.stored[id] = true;
+    }
+
+    const uint16_t lastId = firstId + count - 1;
+    phone.ackedId = lastId;
+    if (phone.faults.cutAfterRecords && lastId == History_id(0)) {
+        phone.faults.cutAfterRecords = false;
+        phone.linkDown = true;
+        Host_setConnected(false);
+    }
+
+    reply(SYNC_CMD_ACK, lastId);
+    if (phone.faults.duplicateAcks) reply(SYNC_CMD_ACK, lastId);
+}
+
+static void onSplits(int32_t id, const Tuple * payload)
+{
+    uint8_t expected[SPLITS_SIZE];
+    readSplits(expected, sizeof(expected));
+    phone.splitsOk = payload && payload->length == SPLITS_SIZE && memcmp(payload->value->data, expected, SPLITS_SIZE) == 0;
+    phone.splitsId = id;
+    reply(SYNC_CMD_SPLITS_ACK, id);
+}
+
+static HostDelivery onWatchFrame(DictionaryIterator * iter)
+{
+    const Tuple * command = dict_find(iter, SYNC_KEY_COMMAND);
+    const Tuple * id      = dict_find(iter, SYNC_KEY_ID);
+    if (!command || !id) return HOST_DELIVER;
+
+    if (phone.linkDown || chance(phone.faults.dropPercent)) return HOST_DROP;
+    if (chance(phone.faults.nackPercent)) return HOST_NACK;
+
+    switch (command->value->int32) {
+    case SYNC_CMD_HELLO:
+        request();
+        break;
+    case SYNC_CMD_RECORDS:
+        onRecords(id->value->int32, dict_find(iter, SYNC_KEY_COUNT)->value->int32, dict_find(iter, SYNC_KEY_PAYLOAD));
+        break;
+    case SYNC_CMD_SPLITS:
+        if (phone.faults.lostSplitsFrames > 0) {
+            --phone.faults.lostSplitsFrames;
+            return HOST_DROP;
+        }
+        onSplits(id->value->int32, dict_find(iter, SYNC_KEY_PAYLOAD));
+        break;
+    case SYNC_CMD_DONE:
+        phone.done = true;
+        break;
+    }
+    return HOST_DELIVER;
+}
+
+//
+// runs
+
+static bool phoneHasAll()
+{
+    for (int age = 0; age < History_count(); ++age) {
+        if (!phone.stored[History_id(age)]) return false;
+    }
+    return phone.splitsId == History_id(0) && phone.splitsOk;
+}
+
+// syncs from scratch, returns the virtual ms until the phone had everything or -1
+static int64_t run(const Faults * faults, uint32_t seed, bool reconnect)
+{
+    Host_reset(START_TIME);
+    Host_loadPersist(persist, persistSize);
+    Host_setOutboxHandler(onWatchFrame, LATENCY_MS);
+
+    memset(&phone, 0, sizeof(phone));
+    phone.faults      = *faults;
+    phone.ackedId     = -1;
+    phone.splitsId    = -1;
+    phone.randomState = seed;
+
+    Sync_init(readSplits);
+    const int64_t start = Host_now();
+    request();
+
+    int64_t elapsed = -1;
+    for (int64_t t = STEP_MS; t <= RUN_MS; t += STEP_MS) {
+        Host_runFor(STEP_MS);
+        if (phone.done && phoneHasAll()) {
+            elapsed = Host_now() - start;
+            break;
+        }
+
+        // the phone comes back, the watch says hello
+        if (phone.linkDown && reconnect && t == RECONNECT_MS) {
+            phone.linkDown = false;
+            Host_setConnected(true);
+        }
+        // a sync that gave up starts again when the app is opened the next time
+        if (!phone.linkDown && t % REQUEST_MS == 0) request();
+    }
+    Sync_deinit();
+    return elapsed;
+}
+
+static void check(const char * name, const Faults * faults)
+{
+    const int64_t elapsed = run(faults, 1, true);
+    if (elapsed < 0) {
+        printf("  FAIL %s: the phone has %s\n", name,
+               phoneHasAll() ? "everything but no done" : "not everything");
+        ++failures;
+        return;
+    }
+    printf("  %-36s %6.1f s, %3u frames sent, %d requests\n", name, elapsed / 1000.0,
+           hostCounters.appMessagesSent, phone.requests);
+}
+
+int main(int argc, char ** argv)
+{
+    const uint32_t seed = argc > 1 ? strtoul(argv[1], NULL, 10) : 1;
+    const int lossyRuns = argc > 2 ? atoi(argv[2]) : 50;
+
+    Host_reset(START_TIME);
+    for (int i = 0; i < WORKOUTS; ++i) {
+        const HistoryRecord record = workoutRecord(i);
+        History_add(&record);
+    }
+    persistSize = Host_savePersist(persist, sizeof(persist));
+    if (!persistSize) return 1;
+
+    printf("== sync loopback, %d workouts, %d ms latency\n", History_count(), LATENCY_MS);
+
+    const Faults clean = { 0 };
+    const int64_t elapsed = run(&clean, seed, false);
+    if (elapsed > 0) {
+        printf("  clean link: %d records in %.1f s, %.1f records/s\n", History_count(), elapsed / 1000.0,
+               History_count() * 1000.0 / elapsed);
+    } else {
+        printf("  FAIL clean link\n");
+        ++failures;
+    }
+
+    check("lost ack, the watch times out", &(Faults){ .lostAcks = 1 });
+    check("duplicate acks, lost splits frame", &(Faults){ .duplicateAcks = true, .lostSplitsFrames = 1 });
+    check("link lost before the splits", &(Faults){ .cutAfterRecords = true });
+    check("rejected frames", &(Faults){ .nackPercent = 50 });
+
+    // lossy links both ways
+    const Faults lossy = { .dropPercent = 10, .nackPercent = 5, .replyDropPercent = 10 };
+    int64_t total = 0;
+    int worst = 0;
+    for (int i = 0; i < lossyRuns; ++i) {
+        const int64_t ms = run(&lossy, seed + i, true);
+        if (ms < 0) {
+            printf("  FAIL lossy link, seed %u\n", seed + i);
+            ++failures;
+            continue;
+        }
+        total += ms;
+        if (ms > worst) worst = ms;
+    }
+    if (lossyRuns > 0) {
+        printf("  lossy link: %.1f s on average, %.1f s at worst, %.1f records/s\n",
+               total / 1000.0 / lossyRuns, worst / 1000.0, History_count() * 1000.0 * lossyRuns / total);
+    }
+
+    printf("  %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
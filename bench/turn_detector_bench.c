@@ -0,0 +1,295 @@
+// Measures how well TurnDetector finds push-offs and how fast it runs.
+//
+//   turn_detector_bench [trace.csv ...]
+//
+// Without arguments it runs on generated traces of a few kinds of swimmers,
+// with the push-offs known. A recorded trace is a CSV file at 25 Hz with one
+// sample per line, "x,y,z[,turn[,vibrating]]" in mG; turn is 1 on the first
+// sample of a push-off. Lines starting with # are skipped.
+//
+// The samples go through the detector as in the app: samples taken while the
+// watch vibrated are skipped, and a missed push-off is made up for by the
+// swimmer's tap two seconds later, which restarts the detector.
+//
+// Exits with 1 if recall or precision falls below the floors: a false
+// detection starts a lane the swimmer didn't swim, which shows in the lane
+// count and the pace.
+
+#include <math.h>
+
+#include "host.h"
+#include "turn_detector.h"
+
+#define RATE             25
+#define MIN_LANE_SECONDS 10  // AUTO_LANE_MIN_SECONDS of the app
+#define TAP_DELAY        (2 * RATE)
+#define EARLY_TOLERANCE  (RATE / 2)
+#define LATE_TOLERANCE   (3 * RATE / 2)
+#define MAX_SAMPLES      (RATE * 60 * 90)
+#define MIN_RECALL       90.0
+#define MIN_PRECISION    97.0
+
+typedef struct {
+    AccelData samples[MAX_SAMPLES];
+    bool turn[MAX_SAMPLES];
+    uint32_t count;
+} Trace;
+
+static Trace trace;
+
+typedef struct {
+    int turns;
+    int detected;
+    int missed;
+    int falseDetections;
+    int64_t latencySamples;
+} Accuracy;
+
+static Accuracy total;
+
+//
+// generated traces
+
+typedef struct {
+    const char * name;
+    int lanes;
+    double secondsPerLane;
+    double strokeHz;      // arm cycles per second
+    double strokeMg;      // amplitude of the stroke acceleration
+    double pushOffMg;     // peak of a push-off, on top of gravity
+    int pushOffSamples;
+    int restEvery;        // lanes between rests at the wall, 0 for none
+} Swimmer;
+
+static const Swimmer swimmers[] = {
+    { "freestyle, 25 m in 30 s",     40, 30, 0.75,  450, 2600, 5, 10 },
+    { "breaststroke, 25 m in 45 s",  30, 45, 0.55,  700, 2400, 6, 10 },
+    { "sprints, 25 m in 15 s",       20, 15, 0.95,  650, 3000, 4,  4 },
+    { "weak push-offs",              30, 35, 0.60,  400, 1900, 3,  0 },
+    { "open turns, hard strokes",    30, 32, 0.70, 1000, 2200, 4,  0 },
+};
+
+static uint32_t randomState;
+
+static double uniform()
+{
+    randomState = randomState * 1103515245 + 12345;
+    return ((randomState >> 8) & 0xffff) / 65536.0;
+}
+
+static double noise(double mg)
+{
+    return (uniform() - 0.5) * 2 * mg;
+}
+
+static void addSample(double x, double y, double z, bool vibrating)
+{
+    if (trace.count == MAX_SAMPLES) return;
+    AccelData * sample = &trace.samples[trace.count];
+    sample->x = (int16_t)fmax(-4000, fmin(4000, x));
+    sample->y = (int16_t)fmax(-4000, fmin(4000, y));
+    sample->z = (int16_t)fmax(-4000, fmin(4000, z));
+    sample->did_vibrate = vibrating;
+    sample->timestamp = trace.count * 1000 / RATE;
+    trace.turn[trace.count] = false;
+    ++trace.count;
+}
+
+// gravity lying on the wrist at the given roll, in radians
+static void addGravity(double roll, double x, double y, double z, bool vibrating)
+{
+    addSample(x + 1000 * sin(roll), y, z - 1000 * cos(roll), vibrating);
+}
+
+static void generate(const Swimmer * swimmer, uint32_t seed)
+{
+    trace.count = 0;
+    randomState = seed;
+
+    for (int lane = 0; lane < swimmer->lanes; ++lane) {
+        // resting at the wall, with a stand-up jolt now and then
+        if (swimmer->restEvery && lane > 0 && lane % swimmer->restEvery == 0) {
+            for (int i = 0; i < 30 * RATE; ++i) {
+                const double jolt = i % (7 * RATE) == 0 ? 1800 : 0;
+                addGravity(0.3, noise(40) + jolt, noise(40), noise(40), false);
+            }
+        }
+
+        // the push-off, then the splashing after it and the app's lane start vibe
+        const uint32_t pushOff = trace.count;
+        const double push = swimmer->pushOffMg * (0.85 + 0.3 * uniform());
+        for (int i = 0; i < swimmer->pushOffSamples; ++i) {
+            const double shape = sin(M_PI * (i + 0.5) / swimmer->pushOffSamples);
+            addGravity(1.4, push * shape + noise(100), noise(100), noise(100), false);
+        }
+        if (pushOff < trace.count) trace.turn[pushOff] = true;
+        for (int i = 0; i < RATE / 2; ++i) {
+            addGravity(1.4, noise(800), noise(800), noise(800), i >= RATE / 5);
+        }
+
+        // glide, strokes, and the approach to the wall with the turn
+        const int laneSamples = (int)((swimmer->secondsPerLane + noise(2)) * RATE);
+        const int glide = RATE;
+        const int turn = RATE * 3 / 2;
+        for (int i = swimmer->pushOffSamples + RATE / 2; i < laneSamples; ++i) {
+            const double t = (double)i / RATE;
+            if (i < glide) {
+                addGravity(1.5, noise(60), noise(60), noise(60), false);
+            } else if (i < laneSamples - turn) {
+                const double phase = 2 * M_PI * swimmer->strokeHz * t;
+                const double catchSpike = fmod(phase, 2 * M_PI) < 0.3 ? swimmer->strokeMg * 0.8 : 0;
+                addGravity(1.5 + 0.8 * sin(phase), swimmer->strokeMg * sin(phase) + catchSpike + noise(120),
+                           swimmer->strokeMg * 0.5 * cos(phase) + noise(120), noise(120), false);
+            } else {
+                // the body rolls over into the turn
+                const double roll = 1.5 + M_PI * (i - (laneSamples - turn)) / turn;
+                addGravity(roll, noise(300), noise(300), noise(300), false);
+            }
+        }
+    }
+}
+
+//
+// recorded traces
+
+static bool load(const char * path)
+{
+    FILE * file = fopen(path, "r");
+    if (!file) return false;
+
+    trace.count = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), file) && trace.count < MAX_SAMPLES) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        int x, y, z, turn = 0, vibrating = 0;
+        if (sscanf(line, "%d,%d,%d,%d,%d", &x, &y, &z, &turn, &vibrating) < 3) continue;
+        addSample(x, y, z, vibrating);
+        trace.turn[trace.count - 1] = turn;
+    }
+    fclose(file);
+    return true;
+}
+
+//
+// accuracy
+
+static void evaluate(const char * name)
+{
+    TurnDetector detector;
+    TurnDetector_init(&detector, RATE, MIN_LANE_SECONDS);
+
+    Accuracy accuracy = { 0 };
+    int64_t pendingTurn = -1; // a push-off not detected yet
+    bool first = true;
+
+    for (uint32_t i = 0; i < trace.count; ++i) {
+        const AccelData * sample = &trace.samples[i];
+
+        if (trace.turn[i]) {
+            // the first lane starts from the menu
+            if (first) {
+                first = false;
+                TurnDetector_laneStarted(&detector);
+            } else {
+                if (pendingTurn >= 0) ++accuracy.missed;
+                pendingTurn = i;
+                ++accuracy.turns;
+            }
+        }
+
+        if (!sample->did_vibrate && TurnDetector_addSample(&detector, sample->x, sample->y, sample->z)) {
+            if (pendingTurn >= 0 && (int64_t)i - pendingTurn <= LATE_TOLERANCE) {
+                ++accuracy.detected;
+                accuracy.latencySamples += i - pendingTurn;
+                pendingTurn = -1;
+            } else {
+                // too early for the next push-off, or none near at all
+                bool early = false;
+                for (uint32_t j = i + 1; j < trace.count && j <= i + EARLY_TOLERANCE; ++j) early |= trace.turn[j];
+                if (!early) ++accuracy.falseDetections;
+            }
+        }
+
+        // the swimmer taps when the lane didn't start on its own
+        if (pendingTurn >= 0 && (int64_t)i - pendingTurn == TAP_DELAY) {
+            ++accuracy.missed;
+            pendingTurn = -1;
+            TurnDetector_laneStarted(&detector);
+        }
+    }
+    if (pendingTurn >= 0) ++accuracy.missed;
+
+    printf("  %-28s %4d push-offs, %4d found, %3d missed, %3d false, latency %4.0f ms\n", name, accuracy.turns,
+           accuracy.detected, accuracy.missed, accuracy.falseDetections,
+           accuracy.detected ? accuracy.latencySamples * 1000.0 / RATE / accuracy.detected : 0);
+
+    total.turns           += accuracy.turns;
+    total.detected        += accuracy.detected;
+    total.missed          += accuracy.missed;
+    total.falseDetections += accuracy.falseDetections;
+    total.latencySamples  += accuracy.latencySamples;
+}
+
+//
+// speed
+
+static double seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void benchmark()
+{
+    generate(&swimmers[0], 1);
+
+    TurnDetector detector;
+    TurnDetector_init(&detector, RATE, MIN_LANE_SECONDS);
+
+    const int rounds = 200;
+    int detections = 0;
+    const double start = seconds();
+    for (int round = 0; round < rounds; ++round) {
+        for (uint32_t i = 0; i < trace.count; ++i) {
+            const AccelData * sample = &trace.samples[i];
+            detections += TurnDetector_addSample(&detector, sample->x, sample->y, sample->z);
+        }
+    }
+    const double elapsed = seconds() - start;
+    const double samples = (double)rounds * trace.count;
+
+    printf("  %.1f million samples per second on this computer, %.1f ns each (%d detections)\n",
+           samples / elapsed / 1e6, elapsed / samples * 1e9, detections);
+}
+
+int main(int argc, char ** argv)
+{
+    printf("== turn detector at %d Hz, lanes of at least %d s\n", RATE, MIN_LANE_SECONDS);
+
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            if (!load(argv[i])) {
+                fprintf(stderr, "can't read %s\n", argv[i]);
+                return 1;
+            }
+            evaluate(argv[i]);
+        }
+    } else {
+        for (size_t i = 0; i < ARRAY_LENGTH(swimmers); ++i) {
+            generate(&swimmers[i], 1 + i);
+            evaluate(swimmers[i].name);
+        }
+    }
+
+    const double recall = total.turns ? 100.0 * total.detected / total.turns : 0;
+    const double precision =
+        total.detected + total.falseDetections ? 100.0 * total.detected / (total.detected + total.falseDetections) : 0;
+    const bool failed = recall < MIN_RECALL || precision < MIN_PRECISION;
+    printf("  %srecall %.1f%%, precision %.1f%% (at least %.0f%% and %.0f%%)\n", failed ? "FAIL " : "", recall,
+           precision, MIN_RECALL, MIN_PRECISION);
+
+    benchmark();
+    return failed ? 1 : 0;
+}
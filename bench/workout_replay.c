@@ -0,0 +1,297 @@
+// Replays traces of button events through Workout_apply, as the app and the
+// worker see them, and checks the workout after every event.
+//
+//   workout_replay [seed] [random traces]
+//
+// The worker copy catches up exactly at every deadline. The app copy only
+// catches up when its timer ticks, and a gap in a trace skips the ticks, as
+// when the app was closed or its timer fired late. Taps go to both copies at
+// the same time; after each event both must agree and keep the invariants.
+// Exits with 1 at the first broken trace, printing how to replay it.
+
+#include "host.h"
+#include "workout.h"
+
+#define TICK_MS 1000
+
+typedef enum {
+    OP_WAIT,      // time passes, the app ticks
+    OP_GAP,       // time passes, the app doesn't notice
+    OP_TAP,
+    OP_DOUBLE_TAP,
+    OP_PAUSE,
+    OP_CONTINUE,
+    OP_FINISH,
+    OP_EXPECT_LANE,
+    OP_EXPECT_PAUSED,
+    OP_END,
+} Op;
+
+static const char * const opNames[] = {
+    "wait", "gap", "tap", "double tap", "pause", "continue", "finish", "expect lane", "expect paused", "end",
+};
+
+typedef struct {
+    Op op;
+    int32_t value; // milliseconds to wait, or the expected value
+} Step;
+
+typedef struct {
+    const char * name;
+    int lanes;
+    int secondsPerLane;
+    const IntervalTemplate * schedule;
+    Step steps[16];
+} Trace;
+
+static const IntervalTemplate restsEveryTwoLanes = { 1, { { 3, 2, 30, 20 } } };
+
+static const Trace scriptedTraces[] = {
+    { "tap just after a deadline the app missed", 10, 30, NULL,
+      { { OP_GAP, 30050 }, { OP_TAP }, { OP_EXPECT_LANE, 3 }, { OP_WAIT, 5000 }, { OP_END } } },
+    { "taps before the deadlines", 10, 30, NULL,
+      { { OP_WAIT, 28000 }, { OP_TAP }, { OP_WAIT, 27000 }, { OP_TAP }, { OP_WAIT, 26500 }, { OP_TAP },
+        { OP_EXPECT_LANE, 4 }, { OP_END } } },
+    { "double tap just after a missed deadline", 10, 30, NULL,
+      { { OP_GAP, 30100 }, { OP_DOUBLE_TAP }, { OP_EXPECT_LANE, 2 }, { OP_WAIT, 40000 }, { OP_END } } },
+    { "pause across a deadline", 10, 30, NULL,
+      { { OP_WAIT, 29000 }, { OP_PAUSE }, { OP_WAIT, 60000 }, { OP_EXPECT_LANE, 1 }, { OP_CONTINUE },
+        { OP_WAIT, 1500 }, { OP_EXPECT_LANE, 2 }, { OP_END } } },
+    { "pause just after a missed deadline", 10, 30, NULL,
+      { { OP_GAP, 30020 }, { OP_PAUSE }, { OP_EXPECT_LANE, 2 }, { OP_WAIT, 5000 }, { OP_CONTINUE },
+        { OP_WAIT, 30000 }, { OP_END } } },
+    { "the last lane pauses the workout", 3, 20, NULL,
+      { { OP_WAIT, 70000 }, { OP_EXPECT_PAUSED, 1 }, { OP_EXPECT_LANE, 3 }, { OP_TAP }, { OP_CONTINUE },
+        { OP_EXPECT_LANE, 4 }, { OP_WAIT, 10000 }, { OP_EXPECT_PAUSED, 0 }, { OP_FINISH }, { OP_END } } },
+    { "app closed for ten minutes", 40, 30, NULL,
+      { { OP_WAIT, 12000 }, { OP_GAP, 600000 }, { OP_TAP }, { OP_EXPECT_LANE, 22 }, { OP_WAIT, 31000 }, { OP_END } } },
+    { "rests, skipped and restarted", 6, 30, &restsEveryTwoLanes,
+      { { OP_WAIT, 29000 }, { OP_TAP }, { OP_WAIT, 30000 }, { OP_TAP }, { OP_WAIT, 5000 }, { OP_TAP },
+        { OP_GAP, 50100 }, { OP_DOUBLE_TAP }, { OP_WAIT, 200000 }, { OP_EXPECT_PAUSED, 1 }, { OP_END } } },
+    { "finish after a missed deadline", 10, 30, NULL,
+      { { OP_GAP, 30500 }, { OP_FINISH }, { OP_END } } },
+    { "two taps 400 ms apart", 40, 30, NULL,
+      { { OP_WAIT, 28000 }, { OP_TAP }, { OP_WAIT, 400 }, { OP_TAP }, { OP_WAIT, 14000 }, { OP_EXPECT_LANE, 5 },
+        { OP_END } } },
+};
+
+//
+// replay
+
+typedef struct {
+    WorkoutState app;
+    WorkoutState worker;
+    IntervalSchedule schedule;
+    IntervalSchedule workerSchedule; // as the worker reads it from persist
+    WorkoutClock now;
+    WorkoutClock nextTick;
+    bool finished;
+    int events;
+    const char * failure;
+    char message[160];
+} Replay;
+
+static bool sameState(const WorkoutState * a, const WorkoutState * b)
+{
+    return a->laneCount == b->laneCount && a->desiredLaneCount == b->desiredLaneCount &&
+           a->paused == b->paused && a->resting == b->resting &&
+           a->timePerLane == b->timePerLane && a->timeOfPreviousLane == b->timeOfPreviousLane &&
+           a->pauseTimeOfPreviousLane == b->pauseTimeOfPreviousLane &&
+           a->startTimeOfCurrentLane == b->startTimeOfCurrentLane &&
+           a->cumulatedPauseTimeOfWorkout == b->cumulatedPauseTimeOfWorkout &&
+           a->cumulatedPauseTimeOfCurrentLane == b->cumulatedPauseTimeOfCurrentLane &&
+           (a->paused ? a->startTimeOfCurrentPause == b->startTimeOfCurrentPause
+                      : a->virtualEndTimeOfCurrentLane == b->virtualEndTimeOfCurrentLane);
+}
+
+static void fail(Replay * replay, const char * what, const WorkoutState * state)
+{
+    if (replay->failure) return;
+    replay->failure = what;
+    snprintf(replay->message, sizeof(replay->message), "at %d ms, lane %d%s%s", (int)replay->now,
+             state->laneCount, state->paused ? ", paused" : "", state->resting ? ", resting" : "");
+}
+
+static const IntervalSchedule * scheduleOf(Replay * replay, const WorkoutState * state)
+{
+    return state == &replay->worker ? &replay->workerSchedule : &replay->schedule;
+}
+
+static void apply(Replay * replay, WorkoutState * state, uint8_t type, WorkoutClock time)
+{
+    Workout_apply(state, scheduleOf(replay, state), (WorkoutEvent){ .type = type, .time = time });
+    ++replay->events;
+
+    // the finished workout is only read for the summary
+    if (type == WORKOUT_EVENT_FINISH) return;
+
+    const char * broken = Workout_checkInvariants(state, scheduleOf(replay, state), time);
+    if (broken) fail(replay, broken, state);
+}
+
+static void start(Replay * replay, const Trace * trace)
+{
+    *replay = (Replay){ .nextTick = TICK_MS };
+
+    if (trace->schedule) Interval_compile(trace->schedule, &replay->schedule);
+    Workout_start(&replay->app, 1700000000, 0, trace->secondsPerLane * 1000, trace->lanes, &replay->schedule);
+    replay->worker = replay->app;
+    memcpy(&replay->workerSchedule, &replay->schedule, INTERVAL_SCHEDULE_SIZE(&replay->schedule));
+}
+
+static void advance(Replay * replay, int32_t ms, bool appTicks)
+{
+    const WorkoutClock end = replay->now + ms;
+
+    // the worker's timer fires at each deadline
+    while (!replay->finished && !Workout_isPaused(&replay->worker) &&
+           replay->worker.virtualEndTimeOfCurrentLane <= end && !replay->failure) {
+        replay->now = replay->worker.virtualEndTimeOfCurrentLane;
+        apply(replay, &replay->worker, WORKOUT_EVENT_CATCH_UP, replay->now);
+    }
+
+    // the app's once a second, unless it missed them
+    for (; replay->nextTick <= end; replay->nextTick += TICK_MS) {
+        if (appTicks && !replay->finished) apply(replay, &replay->app, WORKOUT_EVENT_CATCH_UP, replay->nextTick);
+    }
+    replay->now = end;
+}
+
+// Both copies must agree once they have seen the same time
+static void compare(Replay * replay)
+{
+    if (replay->finished) return;
+
+    WorkoutState app = replay->app;
+    WorkoutState worker = replay->worker;
+    Workout_apply(&app, &replay->schedule, (WorkoutEvent){ .type = WORKOUT_EVENT_CATCH_UP, .time = replay->now });
+    Workout_apply(&worker, &replay->workerSchedule, (WorkoutEvent){ .type = WORKOUT_EVENT_CATCH_UP, .time = replay->now });
+    if (!sameState(&app, &worker)) {
+        fail(replay, "app and worker disagree", &app);
+        snprintf(replay->message, sizeof(replay->message), "at %d ms: app at lane %d%s, worker at lane %d%s",
+                 (int)replay->now, app.laneCount, app.paused ? " paused" : "", worker.laneCount,
+                 worker.paused ? " paused" : "");
+    }
+}
+
+static void tap(Replay * replay, uint8_t type)
+{
+    if (replay->finished) return;
+    apply(replay, &replay->app, type, replay->now);
+    apply(replay, &replay->worker, type, replay->now);
+}
+
+// runs one step, returns false at the end of the trace
+static bool step(Replay * replay, const Step * s)
+{
+    switch (s->op) {
+    case OP_WAIT:       advance(replay, s->value, true);  break;
+    case OP_GAP:        advance(replay, s->value, false); break;
+    case OP_TAP:        tap(replay, WORKOUT_EVENT_NEXT_LANE); break;
+    case OP_DOUBLE_TAP: tap(replay, WORKOUT_EVENT_RESTART_LANE); break;
+    case OP_PAUSE:      tap(replay, WORKOUT_EVENT_PAUSE); break;
+    case OP_CONTINUE:   tap(replay, WORKOUT_EVENT_CONTINUE); break;
+    case OP_FINISH:
+        // the worker is killed, only the app sees the finish
+        apply(replay, &replay->app, WORKOUT_EVENT_FINISH, replay->now);
+        replay->finished = true;
+        break;
+    case OP_EXPECT_LANE:
+        if (replay->app.laneCount != s->value) fail(replay, "unexpected lane", &replay->app);
+        break;
+    case OP_EXPECT_PAUSED:
+        if (Workout_isPaused(&replay->app) != (s->value != 0)) fail(replay, "unexpected pause state", &replay->app);
+        break;
+    case OP_END:
+        return false;
+    }
+    compare(replay);
+    return true;
+}
+
+//
+// random traces
+
+static uint32_t randomState;
+
+static uint32_t nextRandom(uint32_t range)
+{
+    randomState = randomState * 1103515245 + 12345;
+    return (randomState >> 8) % range;
+}
+
+static Step randomStep()
+{
+    const uint32_t r = nextRandom(100);
+    if (r < 35) return (Step){ OP_WAIT, nextRandom(40000) };
+    if (r < 45) return (Step){ OP_GAP, nextRandom(r < 37 ? 600000 : 3000) };
+    if (r < 75) return (Step){ OP_TAP };
+    if (r < 83) return (Step){ OP_DOUBLE_TAP };
+    if (r < 91) return (Step){ OP_PAUSE };
+    return (Step){ OP_CONTINUE };
+}
+
+static const IntervalTemplate randomSchedules[] = {
+    { 2, { { 4, 4, 36, 30 }, { 1, 8, 40, 0 } } },
+    { 1, { { 10, 2, 40, 20 } } },
+    { 1, { { 3, 1, 5, 1 } } },
+};
+
+// a trace from the seed, so a failure can be replayed on its own
+static Trace randomTrace(uint32_t seed)
+{
+    randomState = seed;
+    Trace trace = { .name = "random", .lanes = 1 + nextRandom(60), .secondsPerLane = 5 + nextRandom(90) };
+    if (nextRandom(3) == 0) trace.schedule = &randomSchedules[nextRandom(ARRAY_LENGTH(randomSchedules))];
+    return trace;
+}
+
+#define RANDOM_STEPS 120
+
+static bool replayRandom(uint32_t seed, Replay * replay)
+{
+    const Trace trace = randomTrace(seed);
+    start(replay, &trace);
+    for (int i = 0; i < RANDOM_STEPS && !replay->failure; ++i) {
+        const Step s = randomStep();
+        step(replay, &s);
+        if (replay->failure) {
+            printf("  FAIL random trace %u, step %d (%s %d): %s, %s\n", seed, i, opNames[s.op], (int)s.value,
+                   replay->failure, replay->message);
+        }
+    }
+    return !replay->failure;
+}
+
+int main(int argc, char ** argv)
+{
+    const uint32_t seed = argc > 1 ? strtoul(argv[1], NULL, 10) : 1;
+    const int count = argc > 2 ? atoi(argv[2]) : 200;
+
+    printf("== workout replay, seed %u\n", seed);
+
+    int failures = 0;
+    int events = 0;
+    Replay replay;
+
+    for (size_t t = 0; t < ARRAY_LENGTH(scriptedTraces); ++t) {
+        const Trace * trace = &scriptedTraces[t];
+        start(&replay, trace);
+        for (const Step * s = trace->steps; step(&replay, s) && !replay.failure; ++s) {}
+        events += replay.events;
+
+        if (replay.failure) {
+            printf("  FAIL %s: %s, %s\n", trace->name, replay.failure, replay.message);
+            ++failures;
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (!replayRandom(seed + i, &replay)) ++failures;
+        events += replay.events;
+    }
+
+    printf("  %d scripted and %d random traces, %d events: %s\n", (int)ARRAY_LENGTH(scriptedTraces), count, events,
+           failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -1,70 +1,137 @@
 #include <pebble.h>
 #include "clock_digit.h"
+#include "resource_cache.h"
 
 /** This has been copied from TimeStylePebble (https://github.com/freakified/TimeStylePebble)*/
 
-void adjustImagePalette(ClockDigit* this);
+static void adjustImagePalette(GBitmap* image, int fontId);
 
 /*
- * Array mapping numbers to resource ids
+ * Atlas resource per font: all ten glyphs side by side, DIGIT_WIDTH apart
  */
-uint32_t ClockDigit_imageIds[2][10] = {
-  {RESOURCE_ID_CLOCK_DIGIT_0,
-    RESOURCE_ID_CLOCK_DIGIT_1,
-    RESOURCE_ID_CLOCK_DIGIT_2,
-    RESOURCE_ID_CLOCK_DIGIT_3,
-    RESOURCE_ID_CLOCK_DIGIT_4,
-    RESOURCE_ID_CLOCK_DIGIT_5,
-    RESOURCE_ID_CLOCK_DIGIT_6,
-    RESOURCE_ID_CLOCK_DIGIT_7,
-    RESOURCE_ID_CLOCK_DIGIT_8,
-    RESOURCE_ID_CLOCK_DIGIT_9},
-  {RESOURCE_ID_CLOCK_DIGIT_BOLD_0,
-   RESOURCE_ID_CLOCK_DIGIT_BOLD_1,
-   RESOURCE_ID_CLOCK_DIGIT_BOLD_2,
-   RESOURCE_ID_CLOCK_DIGIT_BOLD_3,
-   RESOURCE_ID_CLOCK_DIGIT_BOLD_4,
-   RESOURCE_ID_CLOCK_DIGIT_BOLD_5,
-   RESOURCE_ID_CLOCK_DIGIT_BOLD_6,
-   RESOURCE_ID_CLOCK_DIGIT_BOLD_7,
-   RESOURCE_ID_CLOCK_DIGIT_BOLD_8,
-   RESOURCE_ID_CLOCK_DIGIT_BOLD_9}
+static const uint32_t ClockDigit_atlasIds[2] = {
+  RESOURCE_ID_CLOCK_DIGIT_ATLAS,
+  RESOURCE_ID_CLOCK_DIGIT_BOLD_ATLAS
 };
 
+/*
+ * Glyph cache shared by all digits. Each atlas is loaded and paletted once,
+ * digits only swap between sub bitmap views into it.
+ */
+static GBitmap* ClockDigit_atlases[2];
+static GBitmap* ClockDigit_images[2][10];
+
+/*
+ * Palette shared by all atlases: fg, mid1, mid2, bg
+ */
+static GColor ClockDigit_palette[4];
+
+/*
+ * Number of times a digit layer was marked dirty
+ */
+static uint32_t ClockDigit_redrawCount = 0;
+
+static void updatePalette(GColor fg, GColor bg) {
+  ClockDigit_palette[0] = fg;
+  ClockDigit_palette[1] = fg;
+  ClockDigit_palette[2] = bg;
+  ClockDigit_palette[3] = bg;
+
+  // now, determine what the intermediate colors will be (for AA)
+  #ifdef PBL_COLOR
+    int colorIncrementR = (fg.r * 85 - bg.r * 85) / 3;
+    int colorIncrementG = (fg.g * 85 - bg.g * 85) / 3;
+    int colorIncrementB = (fg.b * 85 - bg.b * 85) / 3;
+
+    ClockDigit_palette[1] = GColorFromRGB(fg.r * 85 - colorIncrementR,
+                                          fg.g * 85 - colorIncrementG,
+                                          fg.b * 85 - colorIncrementB);
+
+    ClockDigit_palette[2] = GColorFromRGB(bg.r * 85 + colorIncrementR,
+                                          bg.g * 85 + colorIncrementG,
+                                          bg.b * 85 + colorIncrementB);
+
+  #endif
+}
+
+static GBitmap* getImage(int number, int fontId) {
+  GBitmap** atlas = &ClockDigit_atlases[fontId];
+  if(!*atlas) {
+    // a cached atlas may still carry the colors of a previous load
+    *atlas = ResourceCache_acquire(ClockDigit_atlasIds[fontId]);
+    if(!*atlas) return NULL;
+    adjustImagePalette(*atlas, fontId);
+  }
+
+  // sub bitmaps share pixels and palette with the atlas
+  GBitmap** image = &ClockDigit_images[fontId][number];
+  if(!*image) {
+    *image = gbitmap_create_as_sub_bitmap(*atlas, GRect(number * DIGIT_WIDTH, 0, DIGIT_WIDTH, DIGIT_HEIGHT));
+  }
+  return *image;
+}
+
+void ClockDigit_loadImages() {
+  updatePalette(GColorBlack, GColorWhite);
+  ClockDigit_redrawCount = 0;
+
+  #if CLOCK_DIGIT_PRELOAD
+    for(int fontId = 0; fontId < 2; fontId++) {
+      for(int number = 0; number < 10; number++) {
+        getImage(number, fontId);
+      }
+    }
+  #endif
+}
+
+void ClockDigit_unloadImages() {
+  for(int fontId = 0; fontId < 2; fontId++) {
+    for(int number = 0; number < 10; number++) {
+      gbitmap_destroy(ClockDigit_images[fontId][number]);
+      ClockDigit_images[fontId][number] = NULL;
+    }
+    ResourceCache_release(ClockDigit_atlases[fontId]);
+    ClockDigit_atlases[fontId] = NULL;
+  }
+}
+
 void ClockDigit_setNumber(ClockDigit* this, int number, int fontId) {
 
   if(this->currentNum != number || this->currentFontId != fontId) {
 
-    // remember the previous image (deleting it here made the simulator not update the UI)
-    GBitmap * prevImage = this->currentImage;
-
     //change over to the new digit image
-    this->currentImageId = ClockDigit_imageIds[fontId][number];
-    this->currentImage = gbitmap_create_with_resource(this->currentImageId);
+    this->currentImage = getImage(number, fontId);
     this->currentNum = number;
     this->currentFontId = fontId;
 
-    //set the palette properly
-    adjustImagePalette(this);
-
-    //set the layer to the new image
+    //set the layer to the new image, this marks only this digit dirty
     bitmap_layer_set_bitmap(this->imageLayer, this->currentImage);
-
-    //now deallocate the previous image
-    gbitmap_destroy(prevImage);
+    ++ClockDigit_redrawCount;
   }
 
   // in case the layer was set to hidden, unhide
-  layer_set_hidden((Layer *)this->imageLayer, false);
+  if(this->hidden) {
+    layer_set_hidden((Layer *)this->imageLayer, false);
+    this->hidden = false;
+    ++ClockDigit_redrawCount;
+  }
 }
 
 void ClockDigit_setBlank(ClockDigit* this) {
-  layer_set_hidden((Layer *)this->imageLayer, true);
+  if(!this->hidden) {
+    layer_set_hidden((Layer *)this->imageLayer, true);
+    this->hidden = true;
+    ++ClockDigit_redrawCount;
+  }
+}
+
+uint32_t ClockDigit_getRedrawCount() {
+  return ClockDigit_redrawCount;
 }
 
 void ClockDigit_offsetPosition(ClockDigit* this, int posOffset) {
   layer_set_frame((Layer*)this->imageLayer,
-                  GRect(this->position.x + posOffset, this->position.y, 48, 71));
+                  GRect(this->position.x + posOffset, this->position.y, DIGIT_WIDTH, DIGIT_HEIGHT));
 }
 
 void ClockDigit_setColor(ClockDigit* this, GColor fg, GColor bg) {
@@ -72,23 +139,14 @@ void ClockDigit_setColor(ClockDigit* this, GColor fg, GColor bg) {
   this->fgColor = fg;
   this->bgColor = bg;
 
-  // now, determine what the intermediate colors will be (for AA)
-  #ifdef PBL_COLOR
-    int colorIncrementR = (fg.r * 85 - bg.r * 85) / 3;
-    int colorIncrementG = (fg.g * 85 - bg.g * 85) / 3;
-    int colorIncrementB = (fg.b * 85 - bg.b * 85) / 3;
-
-    this->midColor1 = GColorFromRGB(fg.r * 85 - colorIncrementR,
-                                     fg.g * 85 - colorIncrementG,
-                                     fg.b * 85 - colorIncrementB);
-
-    this->midColor2 = GColorFromRGB(bg.r * 85 + colorIncrementR,
-                                     bg.g * 85 + colorIncrementG,
-                                     bg.b * 85 + colorIncrementB);
+  updatePalette(fg, bg);
+  this->midColor1 = ClockDigit_palette[1];
+  this->midColor2 = ClockDigit_palette[2];
 
-  #endif
-
-  adjustImagePalette(this);
+  // the glyphs are shared, so every loaded atlas takes the new colors
+  for(int fontId = 0; fontId < 2; fontId++) {
+    adjustImagePalette(ClockDigit_atlases[fontId], fontId);
+  }
 }
 
 void ClockDigit_construct(ClockDigit* this, GPoint pos) {
@@ -97,7 +155,8 @@ void ClockDigit_construct(ClockDigit* this, GPoint pos) {
   this->fgColor = GColorBlack;
   this->position = pos;
 
-  this->imageLayer = bitmap_layer_create(GRect(pos.x, pos.y, 48, 71));
+  this->imageLayer = bitmap_layer_create(GRect(pos.x, pos.y, DIGIT_WIDTH, DIGIT_HEIGHT));
+  this->hidden = false;
 
   ClockDigit_setBlank(this);
   ClockDigit_setNumber(this, 1, 0);
@@ -109,28 +168,32 @@ void ClockDigit_destruct(ClockDigit* this) {
   bitmap_layer_destroy(this->imageLayer);
   this->imageLayer = NULL;
 
-  // deallocate the background image
-  gbitmap_destroy(this->currentImage);
+  // the image is owned by the glyph cache
   this->currentImage = NULL;
 }
 
-void adjustImagePalette(ClockDigit* this) {
-  if(this->currentImage) {
-    GColor* pal = gbitmap_get_palette(this->currentImage);
+static void adjustImagePalette(GBitmap* image, int fontId) {
+  if(image) {
+    GColor* pal = gbitmap_get_palette(image);
 
     #ifdef PBL_COLOR
-      if(this->currentFontId == FONT_SETTING_DEFAULT || this->currentFontId == FONT_SETTING_BOLD) {
-        pal[0] = this->fgColor;
-        pal[1] = this->midColor1;
-        pal[2] = this->midColor2;
-        pal[3] = this->bgColor;
+      if(fontId == FONT_SETTING_DEFAULT || fontId == FONT_SETTING_BOLD) {
+        // the glyphs index the four colors of updatePalette(), no more
+        if(gbitmap_get_format(image) != GBitmapFormat2BitPalette) {
+          APP_LOG(APP_LOG_LEVEL_ERROR, "digit atlas %d isn't a 4 color palette", fontId);
+          return;
+        }
+        pal[0] = ClockDigit_palette[0];
+        pal[1] = ClockDigit_palette[1];
+        pal[2] = ClockDigit_palette[2];
+        pal[3] = ClockDigit_palette[3];
       } else { // LECO only has two colors
-        pal[0] = this->fgColor;
-        pal[1] = this->bgColor;
+        pal[0] = ClockDigit_palette[0];
+        pal[1] = ClockDigit_palette[3];
       }
     #else
-      pal[0] = this->fgColor;
-      pal[1] = this->bgColor;
+      pal[0] = ClockDigit_palette[0];
+      pal[1] = ClockDigit_palette[3];
     #endif
   }
 }
@@ -7,6 +7,21 @@
 #define FONT_SETTING_DEFAULT 0
 #define FONT_SETTING_BOLD    1
 
+#define DIGIT_WIDTH  48
+#define DIGIT_HEIGHT 71
+
+/*
+ * Build-time switch for the glyph cache: 1 loads all digit images when the
+ * cache is loaded, 0 loads each image on first use (saves heap on aplite).
+ */
+#ifndef CLOCK_DIGIT_PRELOAD
+  #ifdef PBL_PLATFORM_APLITE
+    #define CLOCK_DIGIT_PRELOAD 0
+  #else
+    #define CLOCK_DIGIT_PRELOAD 1
+  #endif
+#endif
+
 /*
  * Represents a single digit, as shown on the clock.
  */
@@ -17,19 +32,36 @@ typedef struct {
   GColor midColor1;
   GColor midColor2;
   GPoint position;
-  uint32_t currentImageId;
   int currentFontId;
+  bool hidden;
   GBitmap* currentImage;
   BitmapLayer* imageLayer;
 } ClockDigit;
 
 /*
- * Sets the number shown. Allocates the appropriate background image.
+ * Loads / frees the glyph cache shared by all digits. The cache has to stay
+ * loaded as long as any digit is constructed. Loading resets the glyph colors
+ * to black on white.
+ */
+void ClockDigit_loadImages();
+void ClockDigit_unloadImages();
+
+/*
+ * Sets the number shown. Takes the image from the glyph cache. The layer is
+ * only marked dirty if the shown glyph or its visibility changes.
  */
 void ClockDigit_setNumber(ClockDigit* this, int number, int fontId);
 void ClockDigit_setBlank(ClockDigit* this);
+/*
+ * Sets the colors. The glyphs are shared, so this affects all digits.
+ */
 void ClockDigit_setColor(ClockDigit* this, GColor fg, GColor bg);
 void ClockDigit_offsetPosition(ClockDigit* this, int posOffset);
 
+/*
+ * Number of times any digit was marked dirty since the glyph cache was loaded
+ */
+uint32_t ClockDigit_getRedrawCount();
+
 void ClockDigit_construct(ClockDigit* this, GPoint pos);
 void ClockDigit_destruct(ClockDigit* this);
@@ -0,0 +1,116 @@
+#include "history.h"
+#include "perf_counters.h"
+
+typedef struct {
+    uint16_t nextId;
+    uint8_t  head;  // slot of the oldest record
+    uint8_t  count;
+    uint32_t startTimes[HISTORY_CAPACITY]; // by slot
+} HistoryIndex;
+
+// the index is read and written as one persist value
+_Static_assert(sizeof(HistoryIndex) <= PERSIST_DATA_MAX_LENGTH, "the history index doesn't fit into one persist key");
+
+static HistoryIndex historyIndex;
+static bool loaded = false;
+
+static int slotOf(int age)
+{
+    return (historyIndex.head + historyIndex.count - 1 - age) % HISTORY_CAPACITY;
+}
+
+// the index is read on first use, not at the start of the app
+static void load()
+{
+    if (loaded) return;
+    loaded = true;
+
+    PERF_COUNT(PERF_PERSIST_READS);
+    if (persist_read_data(PERSIST_KEY_HISTORY_INDEX, &historyIndex, sizeof(historyIndex)) != sizeof(historyIndex)) {
+        memset(&historyIndex, 0, sizeof(historyIndex));
+    }
+}
+
+int History_count()
+{
+    load();
+    return historyIndex.count;
+}
+
+uint16_t History_id(int age)
+{
+    load();
+    return historyIndex.nextId - 1 - age;
+}
+
+bool History_get(int age, HistoryRecord * record)
+{
+    load();
+    if (age < 0 || age >= historyIndex.count) return false;
+
+    const int slot = slotOf(age);
+    const int offset = (slot % HISTORY_RECORDS_PER_KEY) * sizeof(HistoryRecord);
+
+    PERF_COUNT(PERF_PERSIST_READS);
+    uint8_t buffer[PERSIST_DATA_MAX_LENGTH];
+    const int read = persist_read_data(PERSIST_KEY_HISTORY_RECORDS + slot / HISTORY_RECORDS_PER_KEY,
+                                       buffer, offset + sizeof(HistoryRecord));
+    if (read < offset + (int)sizeof(HistoryRecord)) return false;
+
+    memcpy(record, buffer + offset, sizeof(HistoryRecord));
+    return true;
+}
+
+int History_findByDate(time_t time)
+{
+    load();
+
+    // start times grow with the slots from the oldest to the latest record
+    int lo = 0;
+    int hi = historyIndex.count - 1;
+    int found = -1;
+    while (lo <= hi) {
+        const int mid = (lo + hi) / 2;
+        const int age = historyIndex.count - 1 - mid;
+        if ((time_t)historyIndex.startTimes[slotOf(age)] <= time) {
+            found = age;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+void History_add(const HistoryRecord * record)
+{
+    load();
+
+    int slot;
+    if (historyIndex.count < HISTORY_CAPACITY) {
+        slot = (historyIndex.head + historyIndex.count) % HISTORY_CAPACITY;
+        ++historyIndex.count;
+    } else {
+        // overwrite the oldest one
+        slot = historyIndex.head;
+        historyIndex.head = (historyIndex.head + 1) % HISTORY_CAPACITY;
+    }
+
+    const uint32_t key = PERSIST_KEY_HISTORY_RECORDS + slot / HISTORY_RECORDS_PER_KEY;
+    const int offset = (slot % HISTORY_RECORDS_PER_KEY) * sizeof(HistoryRecord);
+
+    PERF_COUNT(PERF_PERSIST_READS);
+    uint8_t buffer[PERSIST_DATA_MAX_LENGTH];
+    int size = persist_read_data(key, buffer, sizeof(buffer));
+    if (size < 0) size = 0;
+    if (size < offset) memset(buffer + size, 0, offset - size);
+
+    memcpy(buffer + offset, record, sizeof(HistoryRecord));
+    if (size < offset + (int)sizeof(HistoryRecord)) size = offset + sizeof(HistoryRecord);
+    persist_write_data(key, buffer, size);
+
+    historyIndex.startTimes[slot] = record->startTime;
+    ++historyIndex.nextId;
+    persist_write_data(PERSIST_KEY_HISTORY_INDEX, &historyIndex, sizeof(historyIndex));
+    PERF_ADD(PERF_PERSIST_WRITES, 2);
+}
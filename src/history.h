@@ -0,0 +1,48 @@
+#pragma once
+
+#include "pebble.h"
+
+// persist keys, the records are spread over HISTORY_RECORD_KEYS keys
+#define PERSIST_KEY_HISTORY_INDEX   20
+#define PERSIST_KEY_HISTORY_RECORDS 21
+
+// Persist space of the history: 60 records of 16 bytes in 4 keys plus the
+// index in one key, 1280 bytes of the 4KB an app may use. The capacity is
+// bounded by the index, which has to fit into a single key.
+#define HISTORY_CAPACITY        60
+#define HISTORY_RECORDS_PER_KEY (PERSIST_DATA_MAX_LENGTH / sizeof(HistoryRecord))
+#define HISTORY_RECORD_KEYS     ((HISTORY_CAPACITY + HISTORY_RECORDS_PER_KEY - 1) / HISTORY_RECORDS_PER_KEY)
+
+typedef struct {
+    uint32_t startTime;
+    uint32_t endTime;
+    uint16_t pauseTime;
+    uint16_t laneCount;
+    uint8_t  lengthOfLane;
+    uint8_t  reserved[3];
+} HistoryRecord;
+
+/*
+ * Ring of the last HISTORY_CAPACITY workouts, the oldest is dropped when
+ * full. Lookups only read the index, which is kept in memory, and the one
+ * key holding the record. Adding a workout rewrites one record key and the
+ * index. The index is read on the first call of any of these.
+ */
+int  History_count();
+
+/*
+ * Id of the workout with the given age, ids count every workout ever added
+ */
+uint16_t History_id(int age);
+
+/*
+ * Reads a workout, age 0 is the latest one
+ */
+bool History_get(int age, HistoryRecord * record);
+
+/*
+ * Age of the latest workout started at or before the given time, -1 if none
+ */
+int  History_findByDate(time_t time);
+
+void History_add(const HistoryRecord * record);
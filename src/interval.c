@@ -0,0 +1,51 @@
+#include "interval.h"
+
+#include <stdio.h>
+
+void Interval_compile(const IntervalTemplate * interval, IntervalSchedule * schedule)
+{
+    schedule->laneCount = 0;
+
+    for (int s = 0; s < interval->setCount && s < INTERVAL_MAX_SETS; ++s) {
+        const IntervalSet * set = &interval->sets[s];
+        for (int r = 0; r < set->repeat; ++r) {
+            for (int l = 0; l < set->lanes; ++l) {
+                if (schedule->laneCount == INTERVAL_MAX_LANES) return;
+
+                IntervalLane * lane = &schedule->lanes[schedule->laneCount++];
+                lane->timePerLane = set->timePerLane;
+                lane->rest        = l == set->lanes - 1 ? set->rest : 0;
+            }
+        }
+    }
+
+    if (schedule->laneCount > 0) schedule->lanes[schedule->laneCount - 1].rest = 0;
+}
+
+int Interval_laneCount(const IntervalTemplate * interval)
+{
+    int laneCount = 0;
+    for (int s = 0; s < interval->setCount && s < INTERVAL_MAX_SETS; ++s) {
+        laneCount += interval->sets[s].repeat * interval->sets[s].lanes;
+    }
+    return laneCount < INTERVAL_MAX_LANES ? laneCount : INTERVAL_MAX_LANES;
+}
+
+void Interval_format(const IntervalTemplate * interval, char * str, size_t maxlen)
+{
+    size_t length = 0;
+    str[0] = 0;
+
+    for (int s = 0; s < interval->setCount && s < INTERVAL_MAX_SETS && length < maxlen; ++s) {
+        const IntervalSet * set = &interval->sets[s];
+        char repeat[6] = "";
+        char rest[7]   = "";
+        if (set->repeat > 1) snprintf(repeat, sizeof(repeat), "%dx", set->repeat);
+        if (set->rest > 0)   snprintf(rest,   sizeof(rest),   "+%ds", set->rest);
+
+        const int written = snprintf(str + length, maxlen - length, "%s%s%d@%ds%s",
+                                     s > 0 ? " " : "", repeat, set->lanes, set->timePerLane, rest);
+        if (written < 0) break;
+        length += written;
+    }
+}
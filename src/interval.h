@@ -0,0 +1,63 @@
+#pragma once
+
+// Plain C without any SDK calls, the schedule is shared with the worker.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define INTERVAL_MAX_SETS  6
+#define INTERVAL_MAX_LANES 80 // the schedule fits into one persist value
+
+/*
+ * One set of a structured workout: repeat x (lanes @ timePerLane, rest).
+ * Times are in seconds.
+ */
+typedef struct {
+    uint8_t repeat;
+    uint8_t lanes;
+    uint8_t timePerLane;
+    uint8_t rest;
+} IntervalSet;
+
+/*
+ * A structured workout as stored in persist, e.g.
+ * "4x(4 lanes @ 36s, 30s rest), 8 lanes @ 40s"
+ */
+typedef struct {
+    uint8_t setCount;
+    IntervalSet sets[INTERVAL_MAX_SETS];
+} IntervalTemplate;
+
+typedef struct {
+    uint8_t timePerLane;
+    uint8_t rest;        // after the lane, 0 for none
+} IntervalLane;
+
+/*
+ * A template flattened into one entry per lane, so the running workout finds
+ * the time and rest of lane n at lanes[n - 1]. laneCount 0 is an empty
+ * schedule, the workout then adapts its pace lane by lane.
+ */
+typedef struct {
+    uint8_t laneCount;
+    IntervalLane lanes[INTERVAL_MAX_LANES];
+} IntervalSchedule;
+
+// bytes of the schedule up to its last lane, as it is persisted
+#define INTERVAL_SCHEDULE_SIZE(schedule) (offsetof(IntervalSchedule, lanes) + (schedule)->laneCount * sizeof(IntervalLane))
+
+/*
+ * Flattens the template. Lanes beyond INTERVAL_MAX_LANES are dropped and
+ * there is no rest after the last lane.
+ */
+void Interval_compile(const IntervalTemplate * interval, IntervalSchedule * schedule);
+
+/*
+ * Number of lanes the compiled schedule has, at most INTERVAL_MAX_LANES
+ */
+int Interval_laneCount(const IntervalTemplate * interval);
+
+/*
+ * Short form for the menu, e.g. "4x4@36s+30s 8@40s"
+ */
+void Interval_format(const IntervalTemplate * interval, char * str, size_t maxlen);
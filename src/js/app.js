@@ -0,0 +1,140 @@
+// Companion of the watch app: receives the workout history and keeps it in
+// localStorage, for src/js/export.js to export. The protocol is described in
+// src/sync.h.
+
+var CMD_REQUEST = 1;
+var CMD_ACK     = 2;
+var CMD_HELLO   = 3;
+var CMD_RECORDS = 4;
+var CMD_SPLITS  = 5;
+var CMD_DONE    = 6;
+var CMD_SPLITS_ACK = 7;
+
+var RECORD_SIZE   = 16; // sizeof(HistoryRecord)
+var RETRY_DELAY   = 1000;
+var MAX_RETRIES   = 5;
+
+var KEY_WORKOUT  = 'workout.';    // + id: the workout
+var KEY_SPLITS   = 'splits.';     // + id: its encoded lane splits
+var KEY_LEGACY_WORKOUTS = 'workouts'; // id -> workout, all in one, as stored before
+var KEY_LEGACY_SPLITS   = 'splits';
+var KEY_ACKED    = 'lastAckedId'; // latest workout stored, -1 for none
+var KEY_SPLITS_ACKED = 'lastSplitsId'; // latest workout whose splits are stored, -1 for none
+
+var syncStart = 0;
+var syncRecords = 0;
+
+function load(key, fallback) {
+    try {
+        var value = JSON.parse(localStorage.getItem(key));
+        return value === null ? fallback : value;
+    } catch (e) {
+        return fallback;
+    }
+}
+
+function store(key, value) {
+    localStorage.setItem(key, JSON.stringify(value));
+}
+
+// every workout under a key of its own, so a frame only writes its records
+function migrate() {
+    [[KEY_LEGACY_WORKOUTS, KEY_WORKOUT], [KEY_LEGACY_SPLITS, KEY_SPLITS]].forEach(function(keys) {
+        var all = load(keys[0], null);
+        if (!all) return;
+        Object.keys(all).forEach(function(id) { store(keys[1] + id, all[id]); });
+        localStorage.removeItem(keys[0]);
+    });
+}
+
+function lastAckedId() {
+    return load(KEY_ACKED, -1);
+}
+
+function lastSplitsId() {
+    return load(KEY_SPLITS_ACKED, -1);
+}
+
+function send(message, retries) {
+    retries = retries || 0;
+    Pebble.sendAppMessage(message, null, function() {
+        if (retries < MAX_RETRIES) {
+            setTimeout(function() { send(message, retries + 1); }, RETRY_DELAY);
+        }
+    });
+}
+
+function requestSync() {
+    syncStart = Date.now();
+    syncRecords = 0;
+    // the splits come in a frame of their own, the link may drop before it
+    send({ command: CMD_REQUEST, id: lastAckedId(), splitsId: lastSplitsId() });
+}
+
+// little endian, as the watch stores it
+function readUint(bytes, offset, size) {
+    var value = 0;
+    for (var i = size - 1; i >= 0; --i) {
+        value = value * 256 + bytes[offset + i];
+    }
+    return value;
+}
+
+function decodeRecord(bytes, offset) {
+    return {
+        startTime:    readUint(bytes, offset, 4),
+        endTime:      readUint(bytes, offset + 4, 4),
+        pauseTime:    readUint(bytes, offset + 8, 2),
+        laneCount:    readUint(bytes, offset + 10, 2),
+        lengthOfLane: readUint(bytes, offset + 12, 1)
+    };
+}
+
+function onRecords(firstId, count, payload) {
+    for (var i = 0; i < count; ++i) {
+        var id = (firstId + i) & 0xffff;
+        var workout = decodeRecord(payload, i * RECORD_SIZE);
+        workout.id = id;
+        store(KEY_WORKOUT + id, workout);
+    }
+
+    var lastId = (firstId + count - 1) & 0xffff;
+    store(KEY_ACKED, lastId);
+    syncRecords += count;
+    send({ command: CMD_ACK, id: lastId });
+}
+
+function onSplits(id, payload) {
+    store(KEY_SPLITS + id, payload);
+    store(KEY_SPLITS_ACKED, id);
+    send({ command: CMD_SPLITS_ACK, id: id });
+}
+
+function onDone(id) {
+    var seconds = (Date.now() - syncStart) / 1000;
+    console.log('Sync done at workout ' + id + ': ' + syncRecords + ' records in ' + seconds + 's, ' +
+                (seconds > 0 ? Math.round(syncRecords / seconds) : syncRecords) + ' records/s');
+}
+
+Pebble.addEventListener('ready', function() {
+    migrate();
+    requestSync();
+});
+
+Pebble.addEventListener('appmessage', function(e) {
+    var message = e.payload;
+    switch (message.command) {
+    case CMD_HELLO:
+        requestSync();
+        break;
+    case CMD_RECORDS:
+        onRecords(message.id, message.count, message.payload);
+        break;
+    case CMD_SPLITS:
+        onSplits(message.id, message.payload || []);
+        break;
+    case CMD_DONE:
+        onDone(message.id);
+        break;
+    }
+});
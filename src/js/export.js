@@ -0,0 +1,147 @@
+// Exports the synced workouts as CSV or TCX. The documents are handed to
+// write() piece by piece, one workout at a time, so nothing holds more than
+// the lanes of a single workout.
+
+// escape codes of the lane splits, see src/lane_splits.c
+var ESC_SPLIT   = 0x80;
+var ESC_PAUSE   = 0x81;
+var ESC_RESTART = 0x82;
+var ESC_SPAN    = 0x83;
+
+function readVarint(bytes, pos) {
+    var value = 0;
+    var factor = 1;
+    while (pos < bytes.length) {
+        var b = bytes[pos++];
+        value += (b & 0x7f) * factor;
+        factor *= 128;
+        if (!(b & 0x80)) return { value: value, pos: pos };
+    }
+    return null;
+}
+
+// Calls lane(split) for each record of the encoded splits, times in tenths of
+// a second. Version 1 stored seconds. Returns false on malformed data.
+function forEachSplit(bytes, lane) {
+    if (!bytes || bytes.length < 1 || (bytes[0] !== 1 && bytes[0] !== 2)) return false;
+    var scale = bytes[0] === 1 ? 10 : 1;
+
+    var read = readVarint(bytes, 1);
+    if (!read) return false;
+    var target = read.value;
+    var pos = read.pos;
+
+    var record = { splitTime: 0, pauseTime: 0, laneSpan: 1, restart: false };
+    while (pos < bytes.length) {
+        var code = bytes[pos++];
+        switch (code) {
+        case ESC_PAUSE:
+            read = readVarint(bytes, pos);
+            if (!read) return false;
+            record.pauseTime = read.value * scale;
+            pos = read.pos;
+            continue;
+        case ESC_RESTART:
+            record.restart = true;
+            continue;
+        case ESC_SPAN:
+            if (pos >= bytes.length || bytes[pos] === 0) return false;
+            record.laneSpan = bytes[pos++];
+            continue;
+        case ESC_SPLIT:
+            read = readVarint(bytes, pos);
+            if (!read) return false;
+            record.splitTime = read.value * scale;
+            pos = read.pos;
+            break;
+        default:
+            record.splitTime = (target * record.laneSpan + (code > 127 ? code - 256 : code)) * scale;
+            break;
+        }
+
+        lane(record);
+        record = { splitTime: 0, pauseTime: 0, laneSpan: 1, restart: false };
+    }
+    return true;
+}
+
+function isoTime(seconds) {
+    return new Date(seconds * 1000).toISOString();
+}
+
+function tenths(value) {
+    return (value / 10).toFixed(1);
+}
+
+// workouts sorted by start, oldest first
+function sortedWorkouts(workouts) {
+    return Object.keys(workouts).map(function(id) { return workouts[id]; })
+        .sort(function(a, b) { return a.startTime - b.startTime; });
+}
+
+function exportCsv(workouts, splits, write) {
+    write('workout,start,end,length_of_lane,lanes,pause_s,lane,split_s,lane_pause_s,lanes_merged,restart\n');
+
+    sortedWorkouts(workouts).forEach(function(workout) {
+        var prefix = [workout.id, isoTime(workout.startTime), isoTime(workout.endTime),
+                      workout.lengthOfLane, workout.laneCount, workout.pauseTime].join(',');
+        var rows = [];
+        var lane = 0;
+        var valid = forEachSplit(splits[workout.id], function(split) {
+            // a restart is an attempt at the next lane, not a lane of its own
+            if (!split.restart) lane += split.laneSpan;
+            rows.push([prefix, split.restart ? lane + 1 : lane, tenths(split.splitTime), tenths(split.pauseTime),
+                       split.laneSpan, split.restart ? 1 : 0].join(','));
+        });
+
+        // without splits, or with malformed ones, only the workout itself
+        write(valid && rows.length > 0 ? rows.join('\n') + '\n' : prefix + ',,,,,\n');
+    });
+}
+
+function tcxLap(startTime, seconds, meters) {
+    return '   <Lap StartTime="' + isoTime(startTime) + '">\n' +
+           '    <TotalTimeSeconds>' + seconds.toFixed(1) + '</TotalTimeSeconds>\n' +
+           '    <DistanceMeters>' + meters + '</DistanceMeters>\n' +
+           '    <Calories>0</Calories>\n' +
+           '    <Intensity>Active</Intensity>\n' +
+           '    <TriggerMethod>Manual</TriggerMethod>\n' +
+           '   </Lap>\n';
+}
+
+function exportTcx(workouts, splits, write) {
+    write('<?xml version="1.0" encoding="UTF-8"?>\n' +
+          '<TrainingCenterDatabase xmlns="http://www.garmin.com/xmlschemas/TrainingCenterDatabase/v2">\n' +
+          ' <Activities>\n');
+
+    sortedWorkouts(workouts).forEach(function(workout) {
+        var laps = [];
+        var time = workout.startTime;
+        var valid = forEachSplit(splits[workout.id], function(split) {
+            // a restarted lane was not swum to the end
+            if (!split.restart) {
+                laps.push(tcxLap(time, split.splitTime / 10, split.laneSpan * workout.lengthOfLane));
+            }
+            time += (split.splitTime + split.pauseTime) / 10;
+        });
+        // without splits, or with malformed ones, one lap of the whole workout
+        if (!valid || laps.length === 0) {
+            laps = [tcxLap(workout.startTime, workout.endTime - workout.startTime - workout.pauseTime,
+                           workout.laneCount * workout.lengthOfLane)];
+        }
+
+        write('  <Activity Sport="Other">\n' +
+              '   <Id>' + isoTime(workout.startTime) + '</Id>\n' +
+              laps.join('') +
+              '  </Activity>\n');
+    });
+
+    write(' </Activities>\n' +
+          '</TrainingCenterDatabase>\n');
+}
+
+module.exports = {
+    forEachSplit: forEachSplit,
+    exportCsv: exportCsv,
+    exportTcx: exportTcx
+};
@@ -0,0 +1,189 @@
+#include "lane_splits.h"
+
+#define ENCODING_VERSION 2 // 1 stored seconds instead of tenths
+
+// escape codes, any other byte is the signed delta of a plain lane
+#define ESC_SPLIT   0x80 // varint split time follows, ends the record
+#define ESC_PAUSE   0x81 // varint pause time follows
+#define ESC_RESTART 0x82 // record has the restart flag
+#define ESC_SPAN    0x83 // lane span byte follows, target is scaled by it
+#define MIN_DELTA   (-124)
+#define MAX_DELTA   127
+
+static uint16_t clampToUint16(int value)
+{
+    if (value < 0)      return 0;
+    if (value > 0xffff) return 0xffff;
+    return value;
+}
+
+// a restarted lane stays apart from the swum ones, its time is no lane time;
+// records whose times don't fit together stay apart too, not to lose time
+static bool mergeRecords(LaneSplit * dst, const LaneSplit * a, const LaneSplit * b)
+{
+    if (a->flags != b->flags) return false;
+    if (a->laneSpan + b->laneSpan > 0xff) return false;
+    if (a->splitTime + b->splitTime > 0xffff || a->pauseTime + b->pauseTime > 0xffff) return false;
+
+    dst->splitTime = a->splitTime + b->splitTime;
+    dst->pauseTime = a->pauseTime + b->pauseTime;
+    dst->laneSpan  = a->laneSpan + b->laneSpan;
+    dst->flags     = a->flags;
+    return true;
+}
+
+// merges the older half pairwise, keeps the newer half as is
+void LaneSplits_downsample(LaneSplits * splits)
+{
+    const uint16_t olderHalf = splits->count / 2;
+
+    uint16_t dst = 0;
+    uint16_t src = 0;
+    while (src < olderHalf) {
+        if (src + 1 < olderHalf &&
+            mergeRecords(&splits->records[dst], &splits->records[src], &splits->records[src + 1])) {
+            src += 2;
+        } else {
+            splits->records[dst] = splits->records[src];
+            src += 1;
+        }
+        ++dst;
+    }
+
+    memmove(&splits->records[dst], &splits->records[olderHalf],
+            (splits->count - olderHalf) * sizeof(LaneSplit));
+    splits->count -= olderHalf - dst;
+}
+
+void LaneSplits_reset(LaneSplits * splits)
+{
+    splits->count = 0;
+}
+
+void LaneSplits_append(LaneSplits * splits, int splitTime, int pauseTime, uint8_t flags)
+{
+    if (splits->count == LANE_SPLITS_CAPACITY) {
+        LaneSplits_downsample(splits);
+
+        // every record spans the maximum already, drop the oldest one
+        if (splits->count == LANE_SPLITS_CAPACITY) {
+            memmove(&splits->records[0], &splits->records[1], (splits->count - 1) * sizeof(LaneSplit));
+            --splits->count;
+        }
+    }
+
+    LaneSplit * record = &splits->records[splits->count++];
+    record->splitTime = clampToUint16(splitTime);
+    record->pauseTime = clampToUint16(pauseTime);
+    record->laneSpan  = 1;
+    record->flags     = flags;
+}
+
+static int writeVarint(uint8_t * buffer, size_t size, size_t pos, uint32_t value)
+{
+    do {
+        if (pos >= size) return -1;
+        buffer[pos++] = (value & 0x7f) | (value >= 0x80 ? 0x80 : 0);
+        value >>= 7;
+    } while (value);
+    return pos;
+}
+
+static int readVarint(const uint8_t * buffer, size_t size, size_t pos, uint32_t * value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 32; shift += 7) {
+        if (pos >= size) return -1;
+        const uint8_t byte = buffer[pos++];
+        *value |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return pos;
+    }
+    return -1;
+}
+
+static int writeByte(uint8_t * buffer, size_t size, size_t pos, uint8_t value)
+{
+    if (pos >= size) return -1;
+    buffer[pos++] = value;
+    return pos;
+}
+
+int LaneSplits_encode(const LaneSplits * splits, int target, uint8_t * buffer, size_t size)
+{
+    int pos = writeByte(buffer, size, 0, ENCODING_VERSION);
+    if (pos >= 0) pos = writeVarint(buffer, size, pos, clampToUint16(target));
+
+    for (uint16_t i = 0; i < splits->count && pos >= 0; ++i) {
+        const LaneSplit * record = &splits->records[i];
+
+        if (record->pauseTime > 0) {
+            pos = writeByte(buffer, size, pos, ESC_PAUSE);
+            if (pos >= 0) pos = writeVarint(buffer, size, pos, record->pauseTime);
+        }
+        if (pos >= 0 && (record->flags & LANE_SPLIT_FLAG_RESTART)) {
+            pos = writeByte(buffer, size, pos, ESC_RESTART);
+        }
+        if (pos >= 0 && record->laneSpan != 1) {
+            pos = writeByte(buffer, size, pos, ESC_SPAN);
+            if (pos >= 0) pos = writeByte(buffer, size, pos, record->laneSpan);
+        }
+        if (pos < 0) break;
+
+        const int delta = record->splitTime - clampToUint16(target) * record->laneSpan;
+        if (delta >= MIN_DELTA && delta <= MAX_DELTA) {
+            pos = writeByte(buffer, size, pos, (uint8_t)(int8_t)delta);
+        } else {
+            pos = writeByte(buffer, size, pos, ESC_SPLIT);
+            if (pos >= 0) pos = writeVarint(buffer, size, pos, record->splitTime);
+        }
+    }
+    return pos;
+}
+
+bool LaneSplits_decode(LaneSplits * splits, const uint8_t * buffer, size_t size)
+{
+    LaneSplits_reset(splits);
+
+#if LANE_SPLITS_DECODE_V1
+    if (size < 1 || (buffer[0] != ENCODING_VERSION && buffer[0] != 1)) return false;
+    const int scale = buffer[0] == 1 ? 10 : 1;
+#else
+    if (size < 1 || buffer[0] != ENCODING_VERSION) return false;
+    const int scale = 1;
+#endif
+
+    uint32_t target;
+    int pos = readVarint(buffer, size, 1, &target);
+
+    LaneSplit record = { .laneSpan = 1 };
+    while (pos >= 0 && (size_t)pos < size) {
+        const uint8_t code = buffer[pos++];
+        uint32_t value;
+
+        switch (code) {
+        case ESC_PAUSE:
+            pos = readVarint(buffer, size, pos, &value);
+            record.pauseTime = clampToUint16(value * scale);
+            continue;
+        case ESC_RESTART:
+            record.flags |= LANE_SPLIT_FLAG_RESTART;
+            continue;
+        case ESC_SPAN:
+            if ((size_t)pos >= size || buffer[pos] == 0) return false;
+            record.laneSpan = buffer[pos++];
+            continue;
+        case ESC_SPLIT:
+            pos = readVarint(buffer, size, pos, &value);
+            record.splitTime = clampToUint16(value * scale);
+            break;
+        default:
+            record.splitTime = clampToUint16(((int)target * record.laneSpan + (int8_t)code) * scale);
+            break;
+        }
+
+        if (pos < 0 || splits->count == LANE_SPLITS_CAPACITY) return false;
+        splits->records[splits->count++] = record;
+        record = (LaneSplit){ .laneSpan = 1 };
+    }
+    return pos >= 0;
+}
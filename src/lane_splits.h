@@ -0,0 +1,55 @@
+#pragma once
+
+#include "pebble.h"
+
+// number of records kept per workout, fixed at compile time
+#ifdef PBL_PLATFORM_APLITE
+#define LANE_SPLITS_CAPACITY 64
+#else
+#define LANE_SPLITS_CAPACITY 256
+#endif
+
+// decoding of version 1 in seconds, which the watch never reads back; only the
+// benches need it
+#ifndef LANE_SPLITS_DECODE_V1
+#define LANE_SPLITS_DECODE_V1 0
+#endif
+
+// record flags
+#define LANE_SPLIT_FLAG_RESTART 0x01
+
+typedef struct {
+    uint16_t splitTime;  // swim time in tenths of a second, pauses excluded
+    uint16_t pauseTime;  // pause time in tenths of a second
+    uint8_t  laneSpan;   // number of lanes merged into this record
+    uint8_t  flags;      // LANE_SPLIT_FLAG_*
+} LaneSplit;
+
+/*
+ * Fixed-capacity recorder of the lanes of one workout. Once full, the older
+ * half is downsampled by merging neighbouring records with the same flags, so
+ * the latest lanes always stay at full resolution. Appending is amortized O(1) and never
+ * allocates.
+ */
+typedef struct {
+    LaneSplit records[LANE_SPLITS_CAPACITY];
+    uint16_t  count;
+} LaneSplits;
+
+void LaneSplits_reset(LaneSplits * splits);
+void LaneSplits_append(LaneSplits * splits, int splitTime, int pauseTime, uint8_t flags);
+void LaneSplits_downsample(LaneSplits * splits);
+
+/*
+ * Compact encoding: one signed byte per lane holding the delta to the target
+ * time per lane, escape codes for pauses, restarts, merged lanes and splits
+ * too far off the target. Returns the number of bytes written or -1 if the
+ * buffer is too small.
+ */
+int  LaneSplits_encode(const LaneSplits * splits, int target, uint8_t * buffer, size_t size);
+
+/*
+ * Decodes an encoded buffer, with LANE_SPLITS_DECODE_V1 also the one of
+ * version 1 in seconds. Returns false on malformed data.
+ */
+bool LaneSplits_decode(LaneSplits * splits, const uint8_t * buffer, size_t size);
@@ -1,6 +1,16 @@
 #include "messagebox.h"
 
 #include "pebble.h"
+#include "perf_counters.h"
+#include "resource_cache.h"
+
+typedef struct {
+    char message[MESSAGE_BOX_MAX_LENGTH];
+    VoidFnc okFunction;
+    VoidFnc nokFunction;
+    uint32_t okResourceId;
+    uint32_t nokResourceId;
+} Prompt;
 
 static Window *messageBoxWindow;
 static TextLayer *labelLayer;
@@ -9,90 +19,146 @@ static ActionBarLayer *actionBarLayer;
 static GBitmap * okBitmap;
 static GBitmap * nokBitmap;
 
-static const char * message_   = 0;
-static uint32_t okResourceId_  = 0;
-static uint32_t nokResourceId_ = 0;
-static VoidFnc okFunction_ = 0;
-static VoidFnc nokFunction_ = 0;
+// queue[head] is the prompt on screen while isShown is set
+static Prompt queue[MESSAGE_BOX_QUEUE_SIZE];
+static int head  = 0;
+static int count = 0;
+static bool isShown = false;
 
-static void onOkClicked(ClickRecognizerRef recognizer, void * context)
+static void verticalAlignTextLayer(TextLayer * textLayer)
 {
+    Layer * layer = text_layer_get_layer(textLayer);
+    const GRect bounds = layer_get_bounds(window_get_root_layer(messageBoxWindow));
+    const GRect frame = GRect(0, 0, bounds.size.w - ACTION_BAR_WIDTH, bounds.size.h);
+
+    // measure with the full frame, then center the text vertically
+    layer_set_frame(layer, frame);
+    const GSize content = text_layer_get_content_size(textLayer);
+    layer_set_frame(layer, GRect(frame.origin.x, frame.origin.y + (frame.size.h - content.h - 5) / 2,
+                                 frame.size.w, frame.size.h));
+}
+
+// icons come from the resource cache, so the ones used elsewhere aren't loaded twice
+static void setIcon(GBitmap ** bitmap, uint32_t resourceId, ButtonId button)
+{
+    GBitmap * previous = *bitmap;
+    *bitmap = ResourceCache_acquire(resourceId);
+    ResourceCache_release(previous);
+
+    action_bar_layer_set_icon(actionBarLayer, button, *bitmap);
+}
+
+static void showNext()
+{
+    if (count == 0) return;
+
+    const Prompt * prompt = &queue[head];
+    text_layer_set_text(labelLayer, prompt->message);
+    verticalAlignTextLayer(labelLayer);
+    setIcon(&okBitmap,  prompt->okResourceId,  BUTTON_ID_UP);
+    setIcon(&nokBitmap, prompt->nokResourceId, BUTTON_ID_DOWN);
+
+    isShown = true;
+    window_stack_push(messageBoxWindow, true);
+    PERF_COUNT(PERF_WINDOW_PUSHES);
+}
+
+// closes the prompt on screen, runs the given callback and shows the next one
+static void answer(VoidFnc function)
+{
+    if (!isShown) return;
+
+    head = (head + 1) % MESSAGE_BOX_QUEUE_SIZE;
+    --count;
+    isShown = false;
+
     window_stack_pop(true);
-    if (okFunction_) okFunction_();
+    if (function) function();
+    if (!isShown) showNext();
 }
+
+static void onOkClicked(ClickRecognizerRef recognizer, void * context)
+{
+    answer(queue[head].okFunction);
+}
+
 static void onNOkClicked(ClickRecognizerRef recognizer, void * context)
 {
-    window_stack_pop(true);
-    if (nokFunction_) nokFunction_();
+    answer(queue[head].nokFunction);
+}
+
+// back just dismisses the prompt
+static void onBackClicked(ClickRecognizerRef recognizer, void * context)
+{
+    answer(0);
 }
 
 static void actionBarClickConfigProvider(void * context)
 {
     window_single_click_subscribe(BUTTON_ID_UP,   (ClickHandler) onOkClicked);
     window_single_click_subscribe(BUTTON_ID_DOWN, (ClickHandler) onNOkClicked);
+    window_single_click_subscribe(BUTTON_ID_BACK, (ClickHandler) onBackClicked);
 }
 
-static void verticalAlignTextLayer(TextLayer * textLayer)
+static void initMessageBox()
 {
-    const GRect frame = layer_get_frame(text_layer_get_layer(textLayer));
-    const GSize content = text_layer_get_content_size(textLayer);
-    layer_set_frame(text_layer_get_layer(textLayer),
-                    GRect(frame.origin.x, frame.origin.y + (frame.size.h - content.h - 5) / 2,
-                          frame.size.w, frame.size.h));
-}
+    messageBoxWindow = window_create();
+    window_set_background_color(messageBoxWindow, PBL_IF_COLOR_ELSE(GColorRed, GColorWhite));
 
-static void onMessageBoxLoad(Window *window)
-{
-    Layer * windowRootLayer = window_get_root_layer(window);
+    Layer * windowRootLayer = window_get_root_layer(messageBoxWindow);
     GRect bounds = layer_get_bounds(windowRootLayer);
 
     labelLayer = text_layer_create(GRect(0, 0, bounds.size.w - ACTION_BAR_WIDTH, bounds.size.h));
-    text_layer_set_text(labelLayer, message_);
     text_layer_set_background_color(labelLayer, GColorClear);
     text_layer_set_text_alignment(labelLayer, GTextAlignmentCenter);
     text_layer_set_font(labelLayer, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD));
     layer_add_child(windowRootLayer, text_layer_get_layer(labelLayer));
 
-    verticalAlignTextLayer(labelLayer);
-
-    okBitmap  = gbitmap_create_with_resource(okResourceId_);
-    nokBitmap = gbitmap_create_with_resource(nokResourceId_);
-
     actionBarLayer = action_bar_layer_create();
-    action_bar_layer_set_icon(actionBarLayer, BUTTON_ID_UP, okBitmap);
-    action_bar_layer_set_icon(actionBarLayer, BUTTON_ID_DOWN, nokBitmap);
-    action_bar_layer_add_to_window(actionBarLayer, window);
+    action_bar_layer_add_to_window(actionBarLayer, messageBoxWindow);
     action_bar_layer_set_click_config_provider(actionBarLayer, actionBarClickConfigProvider);
 }
 
-static void onMessageBoxUnload(Window *window)
+void deinitMessageBox()
 {
+    if (!messageBoxWindow) return;
+
     text_layer_destroy(labelLayer);
     action_bar_layer_destroy(actionBarLayer);
+    window_destroy(messageBoxWindow);
 
-    gbitmap_destroy(okBitmap);
-    gbitmap_destroy(nokBitmap);
+    ResourceCache_release(okBitmap);
+    ResourceCache_release(nokBitmap);
 
-    window_destroy(window);
+    labelLayer       = NULL;
+    actionBarLayer   = NULL;
     messageBoxWindow = NULL;
+    okBitmap         = NULL;
+    nokBitmap        = NULL;
+    count            = 0;
+    isShown          = false;
 }
 
 void showMessageBox(const char * msg, VoidFnc okFunction, VoidFnc nokFunction, uint32_t okResourceId, uint32_t nokResourceId)
 {
-    message_       = msg;
-    okFunction_    = okFunction;
-    nokFunction_   = nokFunction;
-    okResourceId_  = okResourceId;
-    nokResourceId_ = nokResourceId;
-
-    if (!messageBoxWindow)
-    {
-        messageBoxWindow = window_create();
-        window_set_background_color(messageBoxWindow, PBL_IF_COLOR_ELSE(GColorRed, GColorWhite));
-        window_set_window_handlers(messageBoxWindow, (WindowHandlers){
-                                       .load   = onMessageBoxLoad,
-                                       .unload = onMessageBoxUnload,
-                                   });
+    if (count == MESSAGE_BOX_QUEUE_SIZE) return;
+    if (!messageBoxWindow) initMessageBox();
+
+    // the same prompt twice in a row would just be answered twice
+    for (int i = 0; i < count; ++i) {
+        const Prompt * queued = &queue[(head + i) % MESSAGE_BOX_QUEUE_SIZE];
+        if (queued->okFunction == okFunction && queued->nokFunction == nokFunction
+                && strncmp(queued->message, msg, sizeof(queued->message) - 1) == 0) return;
     }
-    window_stack_push(messageBoxWindow, true);
+
+    Prompt * prompt = &queue[(head + count) % MESSAGE_BOX_QUEUE_SIZE];
+    strncpy(prompt->message, msg, sizeof(prompt->message) - 1);
+    prompt->message[sizeof(prompt->message) - 1] = 0;
+    prompt->okFunction    = okFunction;
+    prompt->nokFunction   = nokFunction;
+    prompt->okResourceId  = okResourceId;
+    prompt->nokResourceId = nokResourceId;
+    ++count;
+
+    if (!isShown) showNext();
 }
@@ -2,8 +2,16 @@
 
 #include "pebble.h"
 
+#define MESSAGE_BOX_MAX_LENGTH 48
+#define MESSAGE_BOX_QUEUE_SIZE 4
+
 typedef void (*VoidFnc)();
 
+// The message box is built with the first prompt and reused for every later one.
+void deinitMessageBox();
+
+// The message is copied. A prompt shown while another one is still open is
+// queued and shown as soon as the open one got answered.
 void showMessageBox(const char * msg,
                     VoidFnc okFunction, VoidFnc nokFunction,
                     uint32_t okResourceId, uint32_t nokResourceId);
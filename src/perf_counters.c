@@ -0,0 +1,61 @@
+#include "perf_counters.h"
+
+#if PERF_COUNTERS
+
+static uint32_t counters[NUM_PERF_COUNTERS];
+static size_t heapHighWater = 0;
+
+static const char * const counterNames[NUM_PERF_COUNTERS] = {
+    "ticks", "resource loads", "persist reads", "persist writes", "vibrations", "vibration ms", "window pushes",
+    "first frame ms", "baseline heap"
+};
+
+void PerfCounters_add(PerfCounter counter, uint32_t value)
+{
+    counters[counter] += value;
+    PerfCounters_sampleHeap();
+}
+
+uint32_t PerfCounters_get(PerfCounter counter)
+{
+    return counters[counter];
+}
+
+const char * PerfCounters_name(PerfCounter counter)
+{
+    return counterNames[counter];
+}
+
+size_t PerfCounters_heapHighWater()
+{
+    return heapHighWater;
+}
+
+void PerfCounters_sampleHeap()
+{
+    const size_t used = heap_bytes_used();
+    if (used > heapHighWater) heapHighWater = used;
+}
+
+void PerfCounters_format(char * str, size_t maxlen)
+{
+    snprintf(str, maxlen, "T%d R%d P%d/%d V%d/%d W%d H%d",
+             (int)counters[PERF_TICKS],
+             (int)counters[PERF_RESOURCE_LOADS],
+             (int)counters[PERF_PERSIST_READS],
+             (int)counters[PERF_PERSIST_WRITES],
+             (int)counters[PERF_VIBES],
+             (int)counters[PERF_VIBE_MS],
+             (int)counters[PERF_WINDOW_PUSHES],
+             (int)heapHighWater);
+}
+
+void PerfCounters_log()
+{
+    for (int i = 0; i < NUM_PERF_COUNTERS; ++i) {
+        APP_LOG(APP_LOG_LEVEL_INFO, "%s: %d", counterNames[i], (int)counters[i]);
+    }
+    APP_LOG(APP_LOG_LEVEL_INFO, "heap high-water: %d bytes", (int)heapHighWater);
+}
+
+#endif
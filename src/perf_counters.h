@@ -0,0 +1,50 @@
+#pragma once
+
+#include "pebble.h"
+
+// Set to 1 to count what costs battery and heap. The counters are shown in a
+// debug row of the main menu and logged at the end of each workout.
+#ifndef PERF_COUNTERS
+#define PERF_COUNTERS 0
+#endif
+
+typedef enum {
+    PERF_TICKS,
+    PERF_RESOURCE_LOADS,
+    PERF_PERSIST_READS,
+    PERF_PERSIST_WRITES,
+    PERF_VIBES,
+    PERF_VIBE_MS,
+    PERF_WINDOW_PUSHES,
+    PERF_FIRST_FRAME_MS,  // from main() until the main menu is first drawn, 0 on a resumed workout
+    PERF_BASELINE_HEAP,   // heap used then, before the deferred part of the startup
+    NUM_PERF_COUNTERS
+} PerfCounter;
+
+#if PERF_COUNTERS
+
+void PerfCounters_add(PerfCounter counter, uint32_t value);
+uint32_t PerfCounters_get(PerfCounter counter);
+const char * PerfCounters_name(PerfCounter counter);
+size_t PerfCounters_heapHighWater();
+
+/*
+ * Samples heap_bytes_used() for the high-water mark, done on every count
+ */
+void PerfCounters_sampleHeap();
+
+/*
+ * Short one-line form for the menu, e.g. "T12 R3 P4/5 V6/900 W7 H1234", vibes with their ms
+ */
+void PerfCounters_format(char * str, size_t maxlen);
+void PerfCounters_log();
+
+#define PERF_COUNT(counter)      PerfCounters_add((counter), 1)
+#define PERF_ADD(counter, value) PerfCounters_add((counter), (value))
+
+#else
+
+#define PERF_COUNT(counter)
+#define PERF_ADD(counter, value)
+
+#endif
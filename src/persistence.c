@@ -0,0 +1,48 @@
+#include "persistence.h"
+#include "perf_counters.h"
+
+typedef struct {
+    uint32_t key;
+    int *    value;
+    bool     stored;
+    int32_t  storedValue;
+} PersistenceEntry;
+
+static PersistenceEntry entries[PERSISTENCE_MAX_ENTRIES];
+static int entryCount = 0;
+
+void Persistence_registerInt(uint32_t key, int * value)
+{
+    if (entryCount == PERSISTENCE_MAX_ENTRIES) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "Too many persisted values, key %d ignored", (int)key);
+        return;
+    }
+
+    PersistenceEntry * entry = &entries[entryCount++];
+    entry->key    = key;
+    entry->value  = value;
+    entry->stored = persist_exists(key);
+    PERF_COUNT(PERF_PERSIST_READS);
+
+    if (entry->stored) {
+        entry->storedValue = persist_read_int(key);
+        *value = entry->storedValue;
+    }
+}
+
+int Persistence_flush()
+{
+    int written = 0;
+    for (int i = 0; i < entryCount; ++i) {
+        PersistenceEntry * entry = &entries[i];
+
+        if (entry->stored && entry->storedValue == *entry->value) continue;
+
+        persist_write_int(entry->key, *entry->value);
+        PERF_COUNT(PERF_PERSIST_WRITES);
+        entry->stored      = true;
+        entry->storedValue = *entry->value;
+        ++written;
+    }
+    return written;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "pebble.h"
+
+// maximum number of registered values
+#define PERSISTENCE_MAX_ENTRIES 16
+
+/*
+ * Write-behind store for integer settings. A registered variable is loaded
+ * from persistent storage once; Persistence_flush() later writes only the
+ * variables whose value differs from what is stored.
+ */
+void Persistence_registerInt(uint32_t key, int * value);
+
+/*
+ * Writes all changed values. Returns the number of keys written.
+ */
+int  Persistence_flush();
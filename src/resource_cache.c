@@ -0,0 +1,112 @@
+#include "resource_cache.h"
+#include "perf_counters.h"
+
+typedef struct {
+    uint32_t resourceId;
+    GBitmap * bitmap;
+    uint16_t refCount;
+    uint16_t lastUse;
+} CacheEntry;
+
+static CacheEntry entries[RESOURCE_CACHE_CAPACITY];
+static uint16_t useCounter = 0;
+
+static void evict(CacheEntry * entry)
+{
+    gbitmap_destroy(entry->bitmap);
+    entry->bitmap = NULL;
+}
+
+// a free slot, else the least recently used one nobody holds
+static CacheEntry * findSlot()
+{
+    CacheEntry * slot = NULL;
+    for (int i = 0; i < RESOURCE_CACHE_CAPACITY; ++i) {
+        CacheEntry * entry = &entries[i];
+        if (!entry->bitmap) return entry;
+        if (entry->refCount > 0) continue;
+        if (!slot || (uint16_t)(useCounter - entry->lastUse) > (uint16_t)(useCounter - slot->lastUse)) slot = entry;
+    }
+    if (slot) evict(slot);
+    return slot;
+}
+
+GBitmap * ResourceCache_acquire(uint32_t resourceId)
+{
+    ++useCounter;
+
+    for (int i = 0; i < RESOURCE_CACHE_CAPACITY; ++i) {
+        CacheEntry * entry = &entries[i];
+        if (entry->bitmap && entry->resourceId == resourceId) {
+            ++entry->refCount;
+            entry->lastUse = useCounter;
+            return entry->bitmap;
+        }
+    }
+
+    CacheEntry * entry = findSlot();
+    if (!entry) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "Resource cache full, can't load %d", (int)resourceId);
+        return NULL;
+    }
+
+    GBitmap * bitmap = gbitmap_create_with_resource(resourceId);
+    if (!bitmap) {
+        ResourceCache_evictUnused();
+        bitmap = gbitmap_create_with_resource(resourceId);
+        if (!bitmap) return NULL;
+    }
+    PERF_COUNT(PERF_RESOURCE_LOADS);
+
+    entry->resourceId = resourceId;
+    entry->bitmap     = bitmap;
+    entry->refCount   = 1;
+    entry->lastUse    = useCounter;
+    return bitmap;
+}
+
+void ResourceCache_release(GBitmap * bitmap)
+{
+    if (!bitmap) return;
+
+    for (int i = 0; i < RESOURCE_CACHE_CAPACITY; ++i) {
+        CacheEntry * entry = &entries[i];
+        if (entry->bitmap != bitmap) continue;
+
+        if (entry->refCount > 0) --entry->refCount;
+#if !RESOURCE_CACHE_KEEP_UNUSED
+        if (entry->refCount == 0) evict(entry);
+#endif
+        return;
+    }
+}
+
+void ResourceCache_evictUnused()
+{
+    for (int i = 0; i < RESOURCE_CACHE_CAPACITY; ++i) {
+        CacheEntry * entry = &entries[i];
+        if (entry->bitmap && entry->refCount == 0) evict(entry);
+    }
+}
+
+size_t ResourceCache_footprint()
+{
+    size_t bytes = 0;
+    for (int i = 0; i < RESOURCE_CACHE_CAPACITY; ++i) {
+        const GBitmap * bitmap = entries[i].bitmap;
+        if (bitmap) bytes += gbitmap_get_bytes_per_row(bitmap) * gbitmap_get_bounds(bitmap).size.h;
+    }
+    return bytes;
+}
+
+void ResourceCache_log()
+{
+    int used = 0, unused = 0;
+    for (int i = 0; i < RESOURCE_CACHE_CAPACITY; ++i) {
+        if (!entries[i].bitmap) continue;
+        if (entries[i].refCount > 0) ++used;
+        else                         ++unused;
+    }
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Resource cache: %d used, %d unused bitmaps, %d bytes",
+            used, unused, (int)ResourceCache_footprint());
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "pebble.h"
+
+// maximum number of bitmaps held, used or not
+#define RESOURCE_CACHE_CAPACITY 12
+
+/*
+ * 1 keeps bitmaps nobody uses anymore until their slot is needed for another
+ * one, 0 frees them with the last release (saves heap on aplite).
+ */
+#ifndef RESOURCE_CACHE_KEEP_UNUSED
+  #ifdef PBL_PLATFORM_APLITE
+    #define RESOURCE_CACHE_KEEP_UNUSED 0
+  #else
+    #define RESOURCE_CACHE_KEEP_UNUSED 1
+  #endif
+#endif
+
+/*
+ * Shared bitmaps keyed by resource id. Every acquire has to be matched by a
+ * release; the bitmap is owned by the cache and must not be destroyed. If the
+ * heap runs out, unused bitmaps are evicted and the load is retried.
+ * Returns NULL if the bitmap can't be loaded.
+ */
+GBitmap * ResourceCache_acquire(uint32_t resourceId);
+void ResourceCache_release(GBitmap * bitmap);
+
+/*
+ * Frees all bitmaps that are not in use
+ */
+void ResourceCache_evictUnused();
+
+/*
+ * Bytes of pixel data held by the cache
+ */
+size_t ResourceCache_footprint();
+void ResourceCache_log();
@@ -1,31 +1,65 @@
 #include "pebble.h"
 
 #include "clock_digit.h"
+#include "history.h"
+#include "interval.h"
+#include "lane_splits.h"
 #include "messagebox.h"
+#include "perf_counters.h"
+#include "persistence.h"
+#include "resource_cache.h"
+#include "sync.h"
+#include "turn_detector.h"
+#include "workout.h"
+#include "workout_stats.h"
 
 // main menu stuff
 #define NUM_MENU_SECTIONS 3
-#define NUM_1ST_MENU_ITEMS 3
+#define NUM_1ST_MENU_ITEMS 4
 #define NUM_2ND_MENU_ITEMS 1
-#define NUM_3RD_MENU_ITEMS 1
+#define NUM_3RD_MENU_ITEMS (3 + PERF_COUNTERS) // the last row shows the perf counters
 
 // summary menu stuff
-#define NUM_SUMMARY_MENU_ITEMS 6
+#define NUM_SUMMARY_MENU_ITEMS 9
 
 // settings keys
 #define PERSIST_KEY_DESIRED_LANE_COUNT 0
 #define PERSIST_KEY_TIME_PER_LANE      1
 #define PERSIST_KEY_LENGTH_OF_LANE     2
+// 3 - 7 held the last workout before the history existed, only read to migrate it
 #define PERSIST_KEY_LAST_WORKOUT_LENGTH_OF_LANE   3
 #define PERSIST_KEY_LAST_WORKOUT_LANE_COUNT       4
 #define PERSIST_KEY_LAST_WORKOUT_START_OF_WORKOUT 5
 #define PERSIST_KEY_LAST_WORKOUT_CUMULATIVE_PAUSE 6
 #define PERSIST_KEY_LAST_WORKOUT_END_OF_WORKOUT   7
+#define PERSIST_KEY_LAST_WORKOUT_SPLITS           8 // encoded LaneSplits, spread over the next keys
+// 10 is PERSIST_KEY_WORKOUT_CHECKPOINT, see workout.h
+#define PERSIST_KEY_AUTO_LANE                     11
+#define PERSIST_KEY_LAST_WORKOUT_STATS            12
+#define PERSIST_KEY_INTERVAL_TEMPLATES            13
+#define PERSIST_KEY_INTERVAL_TEMPLATE             14 // selected template, 0 for a uniform pace
+#define PERSIST_KEY_COUNTDOWN_CUE                 15
+// 16 is PERSIST_KEY_WORKOUT_SCHEDULE, see workout.h
+#define PERSIST_KEY_WORKOUT_RESUME                17 // WorkoutResume of the workout running when the app closed
+#define PERSIST_KEY_WORKOUT_RESUME_SPLITS         18 // its encoded LaneSplits, spread over the next keys
+// 20 - 24 are used by the history, see history.h
+
+#define NUM_SPLITS_PERSIST_KEYS 2
+
+#define NUM_INTERVAL_TEMPLATES 3
+
+// auto lane detection: 25 samples per wakeup at 25Hz, lanes are at least 10s,
+// which still lets 15s sprints through; off until the swimmer turns it on
+#define AUTO_LANE_SAMPLES_PER_UPDATE 25
+#define AUTO_LANE_MIN_SECONDS        10
 
 // settings variables
 static int desiredLaneCount = 40;
 static int timePerLane      = 36;
 static int lengthOfLane     = 25;
+static int autoLane         = 0;
+static int intervalTemplate = 0;
+static int countdownCue     = 0;
 int * currentValueToChange = NULL;
 
 // layers
@@ -35,9 +69,10 @@ static ActionBarLayer *actionBarLayer;
 static Window * summaryMenuWindow;
 static MenuLayer * summaryMenuLayer;
 
-// icons
+// icons, held by the windows that show them
 static GBitmap * iconUp;
 static GBitmap * iconOK;
+static GBitmap * digitIconOK;
 static GBitmap * iconDown;
 static GBitmap * iconPlay;
 static GBitmap * iconPause;
@@ -46,27 +81,44 @@ static GBitmap * iconPause;
 static Window * digitWindow;
 static ClockDigit clockDigits[4];
 static ActionBarLayer *digitActionBarLayer;
-
-int laneCount = 0;
-time_t startTimeOfWorkout  = 0;
-int timeOfPreviousLane = 0;
-time_t startTimeOfCurrentLane  = 0;
-int cumulatedPauseTimeOfWorkout = 0;
-int cumulatedPauseTimeOfCurrentLane = 0;
-time_t startTimeOfCurrentPause = 0;
-time_t virtualEndTimeOfCurrentLane = 0;
-
-// values from last workout
-int    lastWorkoutLengthOfLane = 0;
-int    lastWorkoutLaneCount = 0;
-time_t lastWorkoutStartTimeOfWorkout  = 0;
-int    lastWorkoutCumulatedPauseTimeOfWorkout = 0;
-time_t lastWorkoutEndTimeOfWorkout  = 0;
+static AppTimer * updateTimer = NULL;
+static AppTimer * cueTimer = NULL;
+static bool cuePlaying = false;
+static TurnDetector turnDetector;
+
+// structured workouts, the built-in ones until other ones are stored
+static IntervalTemplate intervalTemplates[NUM_INTERVAL_TEMPLATES] = {
+    { 2, { { 4, 4, 36, 30 }, { 1, 8, 40, 0 } } },
+    { 1, { { 10, 2, 40, 20 } } },
+    { 1, { { 3, 8, 45, 60 } } },
+};
+
+// state of the running workout, mirrored by the background worker, and the
+// intervals it runs, empty for a uniform pace
+static WorkoutState workout;
+static IntervalSchedule workoutSchedule;
+static bool resumeWorkout = false;
+
+// per-lane records and statistics of the current workout
+static LaneSplits laneSplits;
+static WorkoutStats workoutStats;
+
+// the last workout as kept in the history, shown by the summary; read when
+// the summary is first opened
+static HistoryRecord lastWorkout;
+static bool lastWorkoutRead = false;
 
 // forward declarations
-static void startNextLane();
-static void finishLane();
+static void pushDigitWindow(bool animated);
+static void pushSummaryMenuWindow();
+static void showActionBar();
+static void startNextLaneAt(WorkoutClock now);
+static void laneStarted();
 static void continueCurrentSwim();
+static void scheduleTimeDigitsUpdate();
+static void updateTimeDigits();
+static void firstFrameDrawn();
+static void formtTime(char * str, size_t maxlen, time_t time);
 static void setClickContextProviderForMainMenu(MenuLayer * menuLayer, Window * window);
 
 //
@@ -74,7 +126,15 @@ static void setClickContextProviderForMainMenu(MenuLayer * menuLayer, Window * w
 
 static bool isPaused()
 {
-    return startTimeOfCurrentPause > 0;
+    return Workout_isPaused(&workout);
+}
+
+static WorkoutClock workoutClock()
+{
+    time_t seconds;
+    uint16_t ms;
+    WORKOUT_READ_CLOCK(&seconds, &ms);
+    return Workout_clock(&workout, seconds, ms);
 }
 
 static void updateDigitActionBarLayerIcons()
@@ -84,52 +144,360 @@ static void updateDigitActionBarLayerIcons()
     } else {
         action_bar_layer_set_icon_animated(digitActionBarLayer, BUTTON_ID_SELECT, iconPause, true);
     }
-    action_bar_layer_set_icon_animated(digitActionBarLayer, BUTTON_ID_DOWN, iconOK, true);
+}
+
+static void readLastWorkout();
+static int readEncodedSplits(uint32_t firstKey, uint8_t * buffer, size_t capacity);
+static void writeEncodedSplits(uint32_t firstKey, int target);
+
+//
+// Thin wrappers, so the perf counters see every vibration and window push.
+// The durations are the ones of the system pulses.
+
+#define LONG_PULSE_MS 500
+
+static void vibeLong()
+{
+    vibes_long_pulse();
+    PERF_COUNT(PERF_VIBES);
+    PERF_ADD(PERF_VIBE_MS, LONG_PULSE_MS);
+}
+
+static void vibePattern(VibePattern pattern)
+{
+    vibes_enqueue_custom_pattern(pattern);
+    PERF_COUNT(PERF_VIBES);
+    for (uint32_t i = 0; i < pattern.num_segments; i += 2) {
+        PERF_ADD(PERF_VIBE_MS, pattern.durations[i]);
+    }
+}
+
+static void pushWindow(Window * window, bool animated)
+{
+    window_stack_push(window, animated);
+    PERF_COUNT(PERF_WINDOW_PUSHES);
+}
+
+//
+// Countdown cues: the end of a lane is announced by one vibration pattern,
+// enqueued once so that its last pulse lands on the deadline. That pulse
+// also is the start of the next lane.
+
+typedef struct {
+    const char * name;
+    VibePattern lane;
+    VibePattern finish; // for the last lane
+} CountdownCue;
+
+static const uint32_t cuePulsesLane[]   = { 100, 900, 100, 900, 100, 900, 500 };
+static const uint32_t cuePulsesFinish[] = { 300, 700, 300, 700, 300, 700, 1000 };
+static const uint32_t cueSoftLane[]     = { 50, 950, 50, 950, 50, 950, 250 };
+static const uint32_t cueSoftFinish[]   = { 150, 850, 150, 850, 150, 850, 600 };
+
+#define NUM_COUNTDOWN_CUES 3 // the last one is off
+
+static const CountdownCue countdownCues[NUM_COUNTDOWN_CUES] = {
+    { "3 pulses",      { cuePulsesLane, ARRAY_LENGTH(cuePulsesLane) }, { cuePulsesFinish, ARRAY_LENGTH(cuePulsesFinish) } },
+    { "3 soft pulses", { cueSoftLane,   ARRAY_LENGTH(cueSoftLane) },   { cueSoftFinish,   ARRAY_LENGTH(cueSoftFinish) } },
+    { "Off, lane start only", { NULL, 0 }, { NULL, 0 } },
+};
+
+static const VibePattern * currentCuePattern()
+{
+    const CountdownCue * cue = &countdownCues[countdownCue];
+    const bool lastLane = !Workout_isResting(&workout) && workout.laneCount == workout.desiredLaneCount;
+    return lastLane ? &cue->finish : &cue->lane;
+}
+
+// time from the first pulse of the pattern to its last one
+static int32_t cueLeadTime(const VibePattern * pattern)
+{
+    int32_t lead = 0;
+    for (uint32_t i = 0; i + 1 < pattern->num_segments; ++i) {
+        lead += pattern->durations[i];
+    }
+    return lead;
+}
+
+static void onCueTimer(void * data)
+{
+    cueTimer = NULL;
+    cuePlaying = true;
+    vibePattern(*currentCuePattern());
+}
+
+// Stops a cue that still counts down, the lane is over before its deadline.
+// A cue that reached the deadline just plays its last pulse.
+static void cancelCue()
+{
+    if (cueTimer) {
+        app_timer_cancel(cueTimer);
+        cueTimer = NULL;
+    }
+    if (cuePlaying && Workout_remaining(&workout, workoutClock()) > 0) vibes_cancel();
+    cuePlaying = false;
+}
+
+// arms the cue of the current lane, called whenever its deadline changes
+static void scheduleCue()
+{
+    cancelCue();
+    if (isPaused()) return;
+
+    const VibePattern * pattern = currentCuePattern();
+    if (pattern->num_segments == 0) return;
+
+    // a lane too short for the whole countdown goes without
+    const int32_t delay = Workout_remaining(&workout, workoutClock()) - cueLeadTime(pattern);
+    if (delay < 0) return;
+
+    cueTimer = app_timer_register(delay, onCueTimer, NULL);
+}
+
+//
+// Checkpoint of the running workout, so it survives the app being killed.
+// While the background worker runs, it owns the workout: it keeps the clock
+// running when the app is closed and writes the checkpoint itself.
+
+static void writeWorkoutCheckpoint()
+{
+#if WORKOUT_CHECK_INVARIANTS
+    const WorkoutClock now = workoutClock();
+    const char * broken = Workout_checkInvariants(&workout, &workoutSchedule, now);
+    if (broken) APP_LOG(APP_LOG_LEVEL_ERROR, "Workout at %d ms: %s", (int)now, broken);
+#endif
+
+    if (app_worker_is_running()) return;
+    persist_write_data(PERSIST_KEY_WORKOUT_CHECKPOINT, &workout, sizeof(workout));
+    PERF_COUNT(PERF_PERSIST_WRITES);
+}
+
+// the schedule only changes when a workout starts
+static void writeWorkoutSchedule()
+{
+    if (workoutSchedule.laneCount > 0) {
+        persist_write_data(PERSIST_KEY_WORKOUT_SCHEDULE, &workoutSchedule, INTERVAL_SCHEDULE_SIZE(&workoutSchedule));
+    } else {
+        persist_delete(PERSIST_KEY_WORKOUT_SCHEDULE);
+    }
+    PERF_COUNT(PERF_PERSIST_WRITES);
+}
+
+static bool readWorkoutCheckpoint()
+{
+    PERF_COUNT(PERF_PERSIST_READS);
+    if (persist_get_size(PERSIST_KEY_WORKOUT_CHECKPOINT) != sizeof(workout)) return false;
+    if (persist_read_data(PERSIST_KEY_WORKOUT_CHECKPOINT, &workout, sizeof(workout)) != sizeof(workout)) return false;
+
+    workoutSchedule.laneCount = 0;
+    if (persist_exists(PERSIST_KEY_WORKOUT_SCHEDULE)) {
+        PERF_COUNT(PERF_PERSIST_READS);
+        persist_read_data(PERSIST_KEY_WORKOUT_SCHEDULE, &workoutSchedule, sizeof(workoutSchedule));
+    }
+    return true;
+}
+
+static void clearWorkoutResume();
+
+static void clearWorkoutCheckpoint()
+{
+    persist_delete(PERSIST_KEY_WORKOUT_CHECKPOINT);
+    persist_delete(PERSIST_KEY_WORKOUT_SCHEDULE);
+    PERF_COUNT(PERF_PERSIST_WRITES);
+    clearWorkoutResume();
+}
+
+//
+// The worker doesn't record lanes, so when the app closes during a workout it
+// keeps the splits and statistics along with the state they end at. While the
+// app is closed, the worker only runs into deadlines; the app runs the same
+// ones from that state when it is opened again and records those lanes too.
+
+typedef struct {
+    WorkoutState workout;
+    WorkoutStats stats;
+} WorkoutResume;
+
+static void writeWorkoutResume()
+{
+    const WorkoutResume resume = { .workout = workout, .stats = workoutStats };
+    persist_write_data(PERSIST_KEY_WORKOUT_RESUME, &resume, sizeof(resume));
+    PERF_COUNT(PERF_PERSIST_WRITES);
+    writeEncodedSplits(PERSIST_KEY_WORKOUT_RESUME_SPLITS, workout.timePerLane / 100);
+}
+
+// restores the lanes of the checkpointed workout, false if they weren't kept
+static bool readWorkoutResume()
+{
+    WorkoutResume resume;
+    PERF_COUNT(PERF_PERSIST_READS);
+    if (persist_read_data(PERSIST_KEY_WORKOUT_RESUME, &resume, sizeof(resume)) != sizeof(resume)) return false;
+    if (resume.workout.startTimeOfWorkout != workout.startTimeOfWorkout ||
+        resume.workout.startMsOfWorkout != workout.startMsOfWorkout) {
+        return false;
+    }
+
+    const size_t capacity = NUM_SPLITS_PERSIST_KEYS * PERSIST_DATA_MAX_LENGTH;
+    uint8_t * buffer = malloc(capacity);
+    if (!buffer) return false;
+    const int size = readEncodedSplits(PERSIST_KEY_WORKOUT_RESUME_SPLITS, buffer, capacity);
+    const bool decoded = LaneSplits_decode(&laneSplits, buffer, size);
+    free(buffer);
+    if (!decoded) return false;
+
+    workout = resume.workout;
+    workoutStats = resume.stats;
+    return true;
+}
+
+static void clearWorkoutResume()
+{
+    persist_delete(PERSIST_KEY_WORKOUT_RESUME);
+    for (int i = 0; i < NUM_SPLITS_PERSIST_KEYS; ++i) persist_delete(PERSIST_KEY_WORKOUT_RESUME_SPLITS + i);
+    PERF_COUNT(PERF_PERSIST_WRITES);
+}
+
+static void sendWorkerMessage(uint8_t type, WorkoutClock now)
+{
+    if (!app_worker_is_running()) return;
+
+    AppWorkerMessage message = { .data1 = (uint32_t)now >> 16, .data2 = (uint32_t)now & 0xffff };
+    app_worker_send_message(type, &message);
+}
+
+// hands the current workout over to the worker
+static void startWorkoutWorker()
+{
+    persist_write_data(PERSIST_KEY_WORKOUT_CHECKPOINT, &workout, sizeof(workout));
+    PERF_COUNT(PERF_PERSIST_WRITES);
+
+    if (app_worker_is_running()) {
+        sendWorkerMessage(WORKOUT_MSG_RELOAD, workoutClock());
+    } else {
+        app_worker_launch();
+    }
+}
+
+// records the lane the event of the given type finished
+static void recordPreviousLane(uint8_t type, uint8_t flags)
+{
+    // splits and statistics are kept in tenths of a second
+    LaneSplits_append(&laneSplits, workout.timeOfPreviousLane / 100, workout.pauseTimeOfPreviousLane / 100, flags);
+
+    // an aborted lane is not a lane of the workout; the next one only starts
+    // after a rest, and not at all after the finish
+    if (!(flags & LANE_SPLIT_FLAG_RESTART)) {
+        const int lane = type == WORKOUT_EVENT_FINISH || workout.resting ? workout.laneCount : workout.laneCount - 1;
+        WorkoutStats_add(&workoutStats, lane, workout.timeOfPreviousLane / 100);
+    }
+}
+
+// Runs the lanes that ran out before now one at a time, so each of them is
+// recorded; Workout_apply would catch up as well, but only report the last.
+static uint8_t catchUpLaneByLane(WorkoutClock now)
+{
+    uint8_t result = 0;
+    while (!isPaused() && Workout_remaining(&workout, now) <= 0) {
+        const WorkoutEvent deadline = { .type = WORKOUT_EVENT_CATCH_UP, .time = workout.virtualEndTimeOfCurrentLane };
+        const uint8_t laneResult = Workout_apply(&workout, &workoutSchedule, deadline);
+        if (laneResult & WORKOUT_LANE_FINISHED) recordPreviousLane(WORKOUT_EVENT_CATCH_UP, 0);
+        if (!(laneResult & WORKOUT_CHANGED)) break;
+        result |= laneResult;
+    }
+    return result;
+}
+
+// Runs an event through the workout and the worker's copy of it, and records
+// the lanes it finished. A tap that comes after a deadline the screen hasn't
+// shown yet lands in the lane that deadline started, as it does in the
+// worker. The worker runs into the deadlines on its own and is gone after the
+// finish, so those are not sent.
+static uint8_t applyWorkoutEvent(uint8_t type, WorkoutClock now, uint8_t splitFlags)
+{
+    const uint8_t caughtUp = type != WORKOUT_EVENT_FINISH ? catchUpLaneByLane(now) : 0;
+    if (type == WORKOUT_EVENT_CATCH_UP) return caughtUp;
+
+    const uint8_t result = Workout_apply(&workout, &workoutSchedule, (WorkoutEvent){ .type = type, .time = now });
+    if (!(result & WORKOUT_CHANGED)) return caughtUp | result;
+
+    if (type != WORKOUT_EVENT_FINISH) sendWorkerMessage(type, now);
+    if (result & WORKOUT_LANE_FINISHED) recordPreviousLane(type, splitFlags);
+    return caughtUp | result;
 }
 
 static void quitCurrentSwim()
 {
-    finishLane();
+    time_t seconds;
+    uint16_t ms;
+    WORKOUT_READ_CLOCK(&seconds, &ms);
+    const WorkoutClock now = Workout_clock(&workout, seconds, ms);
+    applyWorkoutEvent(WORKOUT_EVENT_FINISH, now, 0);
+
+    app_worker_kill();
+    clearWorkoutCheckpoint();
 
     // remember last workout
-    const time_t now = time(NULL);
-    lastWorkoutLengthOfLane                = lengthOfLane;
-    lastWorkoutLaneCount                   = laneCount;
-    lastWorkoutStartTimeOfWorkout          = startTimeOfWorkout;
-    lastWorkoutCumulatedPauseTimeOfWorkout = cumulatedPauseTimeOfWorkout;
-    lastWorkoutEndTimeOfWorkout            = now;
-
-    // calculate average swim time and set timePerLane
-    const int swimTime = lastWorkoutEndTimeOfWorkout - lastWorkoutStartTimeOfWorkout - lastWorkoutCumulatedPauseTimeOfWorkout;
-    const int avgTimePerLane = swimTime / lastWorkoutLaneCount;
-    timePerLane = avgTimePerLane;
+    lastWorkout = (HistoryRecord){
+        .startTime    = workout.startTimeOfWorkout,
+        .endTime      = seconds,
+        .pauseTime    = workout.cumulatedPauseTimeOfWorkout / 1000,
+        .laneCount    = workout.laneCount,
+        .lengthOfLane = lengthOfLane,
+    };
+    History_add(&lastWorkout);
+    lastWorkoutRead = true;
+
+    // calculate average swim time in tenths and set timePerLane
+    const int32_t swimTime = now - workout.cumulatedPauseTimeOfWorkout;
+    const int avgTimePerLane = swimTime / 100 / workout.laneCount;
+    timePerLane = (avgTimePerLane + 5) / 10;
+
+    writeEncodedSplits(PERSIST_KEY_LAST_WORKOUT_SPLITS, avgTimePerLane);
+    persist_write_data(PERSIST_KEY_LAST_WORKOUT_STATS, &workoutStats, sizeof(workoutStats));
+    PERF_COUNT(PERF_PERSIST_WRITES);
+    Persistence_flush();
+    Sync_announce();
+
+#if PERF_COUNTERS
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Digit redraws in this workout: %d", (int)ClockDigit_getRedrawCount());
+    ResourceCache_log();
+    PerfCounters_log();
+#endif
 
     window_stack_pop(false);
-    window_stack_push(summaryMenuWindow, true);
+    pushSummaryMenuWindow();
 }
 
 static void setPaused(bool paused)
 {
     if (paused == isPaused()) return;
 
-    const time_t now = time(NULL);
-    if (paused) {
-        startTimeOfCurrentPause = now;
-    } else {
-        cumulatedPauseTimeOfWorkout     += now - startTimeOfCurrentPause;
-        cumulatedPauseTimeOfCurrentLane += now - startTimeOfCurrentPause;
-        startTimeOfCurrentPause = 0;
+    cancelCue();
 
-        virtualEndTimeOfCurrentLane = startTimeOfCurrentLane + timePerLane + cumulatedPauseTimeOfCurrentLane;
-    }
+    applyWorkoutEvent(paused ? WORKOUT_EVENT_PAUSE : WORKOUT_EVENT_CONTINUE, workoutClock(), 0);
 
+    writeWorkoutCheckpoint();
+    scheduleCue();
+    scheduleTimeDigitsUpdate();
     updateDigitActionBarLayerIcons();
 }
 
 static void onDigitActionBarLayerBackClicked(ClickRecognizerRef recognizer, void * context)
 {
     setPaused(true);
-    showMessageBox("Really finish current swim?", quitCurrentSwim, continueCurrentSwim,
+
+    // tell how long the rest of the workout would take
+    static char message[48];
+    const int remaining = WorkoutStats_projectedRemaining(&workoutStats);
+    if (remaining > 0) {
+        char str[10];
+        formtTime(str, sizeof(str), remaining / 10);
+        snprintf(message, sizeof(message), "Really finish current swim? %s to go", str);
+    } else {
+        strcpy(message, "Really finish current swim?");
+    }
+
+    showMessageBox(message, quitCurrentSwim, continueCurrentSwim,
                    RESOURCE_ID_IMAGE_ACTION_ICON_OK, RESOURCE_ID_IMAGE_ACTION_ICON_NOK);
 }
 
@@ -140,8 +508,8 @@ static void onDigitActionBarLayerSelectClicked(ClickRecognizerRef recognizer, vo
 
 static void updateLaneDigits()
 {
-    ClockDigit_setNumber(&clockDigits[0], (laneCount/ 10) % 10, FONT_SETTING_DEFAULT);
-    ClockDigit_setNumber(&clockDigits[1],  laneCount      % 10, FONT_SETTING_DEFAULT);
+    ClockDigit_setNumber(&clockDigits[0], (workout.laneCount/ 10) % 10, FONT_SETTING_DEFAULT);
+    ClockDigit_setNumber(&clockDigits[1],  workout.laneCount      % 10, FONT_SETTING_DEFAULT);
 }
 
 static void continueCurrentSwim()
@@ -149,98 +517,105 @@ static void continueCurrentSwim()
     setPaused(false);
 }
 
+static void startNextLane()
+{
+    cancelCue();
+
+    startNextLaneAt(workoutClock());
+}
+
+// The finished workout is paused at the deadline of its last lane, which a
+// continue would run into again at once. So the next lane starts while still
+// paused, and continuing then only ends that pause.
 static void continueCurrentSwimInNextLane()
 {
-    continueCurrentSwim();
     startNextLane();
+    continueCurrentSwim();
+    updateTimeDigits();
 }
 
 static void updateTimeDigits()
 {
-    const time_t now = time(NULL);
-    int remaining = isPaused() ? virtualEndTimeOfCurrentLane + (now - startTimeOfCurrentPause) - now
-                               : virtualEndTimeOfCurrentLane - now;
-
-    if (remaining <= 0 && !isPaused()) {
-        if (laneCount == desiredLaneCount) {
-            setPaused(true);
+    const int32_t remainingMs = Workout_remaining(&workout, workoutClock());
+    const int remaining = remainingMs > 0 ? (remainingMs + 999) / 1000 : 0; // a second shows until it's over
+
+    if (remainingMs <= 0 && !isPaused()) {
+        // the lane ends at its deadline, just like the worker sees it; the last one pauses the workout
+        applyWorkoutEvent(WORKOUT_EVENT_CATCH_UP, workoutClock(), 0);
+        if (isPaused()) {
+            cancelCue();
+            writeWorkoutCheckpoint();
+            updateDigitActionBarLayerIcons();
             showMessageBox("Yeah, workout finished :-). Quit swim?", quitCurrentSwim, continueCurrentSwimInNextLane,
                            RESOURCE_ID_IMAGE_ACTION_ICON_OK, RESOURCE_ID_IMAGE_ACTION_ICON_NOK);
             return;
         }
-        startNextLane();
+        laneStarted();
         return;
     }
 
-    ClockDigit_setNumber(&clockDigits[2], (remaining / 10) % 10, FONT_SETTING_BOLD);
-    ClockDigit_setNumber(&clockDigits[3],  remaining       % 10, FONT_SETTING_BOLD);
+    // a rest counts down in the thin font
+    const int fontId = Workout_isResting(&workout) ? FONT_SETTING_DEFAULT : FONT_SETTING_BOLD;
+    ClockDigit_setNumber(&clockDigits[2], (remaining / 10) % 10, fontId);
+    ClockDigit_setNumber(&clockDigits[3],  remaining       % 10, fontId);
 
-    if (remaining <= 3 && !isPaused()) {
-        if (laneCount == desiredLaneCount) {
-            vibes_long_pulse();
-        } else {
-            vibes_short_pulse();
-        }
-    }
+    scheduleTimeDigitsUpdate();
 }
 
-static void startNextLane()
+static void onUpdateTimer(void * data)
 {
-    ++laneCount;
-
-    const time_t now = time(NULL);
-
-    // calculate next timePerLane
-    finishLane();
-
-    // start new lane
-    startTimeOfCurrentLane = now;
-    cumulatedPauseTimeOfCurrentLane = 0;
+    updateTimer = NULL;
+    PERF_COUNT(PERF_TICKS);
+    updateTimeDigits();
+}
 
-    if (isPaused()) {
-        startTimeOfCurrentPause = now;
-    } else {
-        virtualEndTimeOfCurrentLane = startTimeOfCurrentLane + timePerLane;
+// Arms a single timer for the next change of the countdown, which is when the
+// remaining time reaches the next full second; the last one is the deadline.
+// While paused the countdown is frozen, so nothing is armed at all.
+static void scheduleTimeDigitsUpdate()
+{
+    if (updateTimer) {
+        app_timer_cancel(updateTimer);
+        updateTimer = NULL;
     }
+    if (isPaused()) return;
 
-    vibes_long_pulse();
-    updateLaneDigits();
-    updateTimeDigits();
+    const int32_t remainingMs = Workout_remaining(&workout, workoutClock());
+    updateTimer = app_timer_register(remainingMs > 0 ? (remainingMs - 1) % 1000 + 1 : 0, onUpdateTimer, NULL);
 }
 
-static void finishLane()
+static void startNextLaneAt(WorkoutClock now)
 {
-    const time_t now = time(NULL);
+    applyWorkoutEvent(WORKOUT_EVENT_NEXT_LANE, now, 0);
+    laneStarted();
+}
 
-    // calculate next timePerLane
-    if (isPaused()) {
-        cumulatedPauseTimeOfWorkout     += now - startTimeOfCurrentPause;
-        cumulatedPauseTimeOfCurrentLane += now - startTimeOfCurrentPause;
-    }
-    if (startTimeOfCurrentLane > 0) {
-        timePerLane = now - startTimeOfCurrentLane - cumulatedPauseTimeOfCurrentLane;
-        timeOfPreviousLane = timePerLane;
-    }
+static void laneStarted()
+{
+    TurnDetector_laneStarted(&turnDetector);
+
+    writeWorkoutCheckpoint();
+
+    // a cue that ran up to the deadline already ended with the lane start pulse
+    if (cuePlaying) cuePlaying = false;
+    else            vibeLong();
+    scheduleCue();
+
+    updateLaneDigits();
+    updateTimeDigits();
 }
 
 static void restartCurrentLane()
 {
-    const time_t now = time(NULL);
+    cancelCue();
 
-    // calculate next timePerLane
-    finishLane();
+    applyWorkoutEvent(WORKOUT_EVENT_RESTART_LANE, workoutClock(), LANE_SPLIT_FLAG_RESTART);
+    TurnDetector_laneStarted(&turnDetector);
 
-    // start new lane
-    startTimeOfCurrentLane = now;
-    cumulatedPauseTimeOfCurrentLane = 0;
+    writeWorkoutCheckpoint();
+    vibeLong();
+    scheduleCue();
 
-    if (isPaused()) {
-        startTimeOfCurrentPause = now;
-    } else {
-        virtualEndTimeOfCurrentLane = startTimeOfCurrentLane + timePerLane;
-    }
-
-    vibes_long_pulse();
     updateLaneDigits();
     updateTimeDigits();
 }
@@ -263,15 +638,23 @@ static void digitActionBarLayerClickConfigProvider(void * context)
     window_multi_click_subscribe(BUTTON_ID_DOWN, 2, 0, 0, true, (ClickHandler)onDigitActionBarLayerDownDoubleClicked);
 }
 
-static void handleSecondsTick(struct tm * tick_time, TimeUnits units_changed)
+static void handleAccelData(AccelData * data, uint32_t numSamples)
 {
-    updateTimeDigits();
+    for (uint32_t i = 0; i < numSamples; ++i) {
+        // our own vibrations would look like a push-off
+        if (data[i].did_vibrate) continue;
+
+        if (TurnDetector_addSample(&turnDetector, data[i].x, data[i].y, data[i].z) && !isPaused()) {
+            startNextLane();
+        }
+    }
 }
 
 static void onDigitWindowLoad(Window * window)
 {
     GPoint digitPoints[4] = {GPoint(7, 7), GPoint(60, 7), GPoint(7, 90), GPoint(60, 90)};
 
+    ClockDigit_loadImages();
     for(int i = 0; i < 4; i++) {
         ClockDigit_construct(&clockDigits[i], digitPoints[i]);
     }
@@ -283,37 +666,86 @@ static void onDigitWindowLoad(Window * window)
     }
 
     // Initialize the action bar:
+    digitIconOK = ResourceCache_acquire(RESOURCE_ID_IMAGE_ACTION_ICON_OK);
+    iconPlay    = ResourceCache_acquire(RESOURCE_ID_IMAGE_ACTION_ICON_PLAY);
+    iconPause   = ResourceCache_acquire(RESOURCE_ID_IMAGE_ACTION_ICON_PAUSE);
+
     digitActionBarLayer = action_bar_layer_create();
     action_bar_layer_set_click_config_provider(digitActionBarLayer, digitActionBarLayerClickConfigProvider);
+    action_bar_layer_set_icon(digitActionBarLayer, BUTTON_ID_DOWN, digitIconOK);
+    action_bar_layer_add_to_window(digitActionBarLayer, window);
 
-    updateDigitActionBarLayerIcons();
+    LaneSplits_reset(&laneSplits);
 
-    action_bar_layer_add_to_window(digitActionBarLayer, window);
+    if (resumeWorkout) {
+        // continue the checkpointed workout, with its lanes if the app kept them
+        resumeWorkout = false;
+        if (!readWorkoutResume()) {
+            LaneSplits_reset(&laneSplits);
+            WorkoutStats_reset(&workoutStats, workout.desiredLaneCount);
+        }
+        clearWorkoutResume();
+        applyWorkoutEvent(WORKOUT_EVENT_CATCH_UP, workoutClock(), 0);
+        if (!app_worker_is_running()) startWorkoutWorker();
+        scheduleCue();
+        updateLaneDigits();
+        updateTimeDigits();
+    } else {
+        time_t seconds;
+        uint16_t ms;
+        WORKOUT_READ_CLOCK(&seconds, &ms);
+        workoutSchedule.laneCount = 0;
+        if (intervalTemplate > 0) Interval_compile(&intervalTemplates[intervalTemplate - 1], &workoutSchedule);
+        Workout_start(&workout, seconds, ms, timePerLane * 1000, desiredLaneCount, &workoutSchedule);
+        WorkoutStats_reset(&workoutStats, workout.desiredLaneCount);
+        writeWorkoutSchedule();
+        startWorkoutWorker();
+
+        vibeLong();
+        scheduleCue();
+        updateLaneDigits();
+        updateTimeDigits();
+    }
 
-    // reset all
-    laneCount = 0;
-    startTimeOfWorkout = time(NULL);
-    timeOfPreviousLane = timePerLane;
-    startTimeOfCurrentLane  = 0;
-    cumulatedPauseTimeOfWorkout = 0;
-    cumulatedPauseTimeOfCurrentLane = 0;
-    startTimeOfCurrentPause = 0;
-    virtualEndTimeOfCurrentLane = 0;
-    startNextLane();
+    updateDigitActionBarLayerIcons();
 
-    tick_timer_service_subscribe(SECOND_UNIT, &handleSecondsTick);
+    if (autoLane) {
+        TurnDetector_init(&turnDetector, ACCEL_SAMPLING_25HZ, AUTO_LANE_MIN_SECONDS);
+        accel_data_service_subscribe(AUTO_LANE_SAMPLES_PER_UPDATE, handleAccelData);
+        accel_service_set_sampling_rate(ACCEL_SAMPLING_25HZ);
+    }
 }
 
 static void onDigitWindowUnload(Window * window)
 {
-    tick_timer_service_unsubscribe();
+    // the app closes while the worker carries on with the workout
+    if (persist_exists(PERSIST_KEY_WORKOUT_CHECKPOINT)) writeWorkoutResume();
+
+    if (autoLane) {
+        accel_data_service_unsubscribe();
+    }
+
+    if (updateTimer) {
+        app_timer_cancel(updateTimer);
+        updateTimer = NULL;
+    }
+    cancelCue();
 
     action_bar_layer_destroy(digitActionBarLayer);
     digitActionBarLayer = NULL;
 
+    ResourceCache_release(digitIconOK);
+    ResourceCache_release(iconPlay);
+    ResourceCache_release(iconPause);
+    digitIconOK = NULL;
+    iconPlay    = NULL;
+    iconPause   = NULL;
+
     for(int i = 0; i < 4; i++) {
         ClockDigit_destruct(&clockDigits[i]);
     }
+
+    ClockDigit_unloadImages();
 }
 
 static void initDigitWindow()
@@ -325,8 +757,15 @@ static void initDigitWindow()
                                });
 }
 
+static void pushDigitWindow(bool animated)
+{
+    if (!digitWindow) initDigitWindow();
+    pushWindow(digitWindow, animated);
+}
+
 static void deinitDigitWindow()
 {
+    if (!digitWindow) return;
     window_destroy(digitWindow);
     digitWindow = NULL;
 }
@@ -366,58 +805,87 @@ static void formtTime(char * str, size_t maxlen, time_t time)
                  );    }
 }
 
-static void onSummaryMenuDrawRow(GContext* ctx, const Layer * cellLayer, MenuIndex * cellIndex, void * data)
+// texts of the summary menu, built once when the window loads
+static struct {
+    char startOfSwim[20];
+    char swimTime[10];
+    char timePerLane[10];
+    char lanes[12];
+    char pause[10];
+    char endOfSwim[20];
+    char bestAndWorstLane[16];
+    char deviation[10];
+    char paceDrift[10];
+} summary;
+
+static const char * const summaryTitles[NUM_SUMMARY_MENU_ITEMS] = {
+    "Start of swim", "Total swim time", "Time per Lane", "Lanes", "Pause", "End of swim",
+    "Best / worst lane", "Lane deviation", "Pace drift"
+};
+static char * const summaryValues[NUM_SUMMARY_MENU_ITEMS] = {
+    summary.startOfSwim, summary.swimTime, summary.timePerLane, summary.lanes, summary.pause, summary.endOfSwim,
+    summary.bestAndWorstLane, summary.deviation, summary.paceDrift
+};
+
+static void formatDate(char * str, size_t maxlen, time_t time)
+{
+    strftime(str, maxlen, "%d.%m.%Y %H:%M:%S", localtime(&time));
+}
+
+static void formatTenths(char * str, size_t maxlen, int tenths, bool withSign)
 {
-    const int swimTime = lastWorkoutEndTimeOfWorkout - lastWorkoutStartTimeOfWorkout - lastWorkoutCumulatedPauseTimeOfWorkout;
-    const int avgTimePerLane = swimTime / lastWorkoutLaneCount;
+    const char * sign = tenths < 0 ? "-" : (withSign ? "+" : "");
+    if (tenths < 0) tenths = -tenths;
+    snprintf(str, maxlen, "%s%d.%ds", sign, tenths / 10, tenths % 10);
+}
 
-    switch (cellIndex->section) {
-    case 0:
-        switch (cellIndex->row) {
-        case 0: {
-            struct tm * tmTime = localtime(&lastWorkoutStartTimeOfWorkout);
-            char str[20];
-            strftime(str, 20, "%d.%m.%Y %H:%M:%S", tmTime);
-            menu_cell_basic_draw(ctx, cellLayer, "Start of swim", str, NULL);
-            break;
-        }
-        case 1: {
-            char str[10];
-            formtTime(str, 10, swimTime);
-            menu_cell_basic_draw(ctx, cellLayer, "Total swim time", str, NULL);
-            break;
-        }
-        case 2: {
-            char str[10];
-            formtTime(str, 10, avgTimePerLane);
-            menu_cell_basic_draw(ctx, cellLayer, "Time per Lane", str, NULL);
-            break;
-        }
-        case 3: {
-            char str[12];
-            snprintf(str, 12, "%d (%dm)", lastWorkoutLaneCount, lastWorkoutLaneCount*lastWorkoutLengthOfLane);
-            menu_cell_basic_draw(ctx, cellLayer, "Lanes", str, NULL);
-            break;
-        }
-        case 4: {
-            char str[10];
-            formtTime(str, 10, lastWorkoutCumulatedPauseTimeOfWorkout);
-            menu_cell_basic_draw(ctx, cellLayer, "Pause", str, NULL);
-            break;
-        }
-        case 5: {
-            struct tm * tmTime = localtime(&lastWorkoutEndTimeOfWorkout);
-            char str[20];
-            strftime(str, 20, "%d.%m.%Y %H:%M:%S", tmTime);
-            menu_cell_basic_draw(ctx, cellLayer, "End of swim", str, NULL);
-            break;
-        }
+static void updateSummary()
+{
+    // nothing swum yet
+    if (lastWorkout.laneCount == 0) {
+        for (int i = 0; i < NUM_SUMMARY_MENU_ITEMS; ++i) {
+            strcpy(summaryValues[i], "-");
         }
+        return;
+    }
+
+    const int swimTime = lastWorkout.endTime - lastWorkout.startTime - lastWorkout.pauseTime;
+    const int avgTimePerLane = swimTime / lastWorkout.laneCount;
+
+    formatDate(summary.startOfSwim, sizeof(summary.startOfSwim), lastWorkout.startTime);
+    formtTime(summary.swimTime, sizeof(summary.swimTime), swimTime);
+    formtTime(summary.timePerLane, sizeof(summary.timePerLane), avgTimePerLane);
+    snprintf(summary.lanes, sizeof(summary.lanes), "%d (%dm)", lastWorkout.laneCount, lastWorkout.laneCount*lastWorkout.lengthOfLane);
+    formtTime(summary.pause, sizeof(summary.pause), lastWorkout.pauseTime);
+    formatDate(summary.endOfSwim, sizeof(summary.endOfSwim), lastWorkout.endTime);
+
+    // the statistics are not known for workouts of older versions
+    if (workoutStats.laneCount == 0) {
+        strcpy(summary.bestAndWorstLane, "-");
+        strcpy(summary.deviation, "-");
+        strcpy(summary.paceDrift, "-");
+        return;
     }
+
+    char best[10];
+    char worst[10];
+    formatTenths(best, sizeof(best), workoutStats.bestLane, false);
+    formatTenths(worst, sizeof(worst), workoutStats.worstLane, false);
+    snprintf(summary.bestAndWorstLane, sizeof(summary.bestAndWorstLane), "%s / %s", best, worst);
+    formatTenths(summary.deviation, sizeof(summary.deviation), WorkoutStats_standardDeviation(&workoutStats), false);
+    formatTenths(summary.paceDrift, sizeof(summary.paceDrift), WorkoutStats_paceDrift(&workoutStats), true);
+}
+
+static void onSummaryMenuDrawRow(GContext* ctx, const Layer * cellLayer, MenuIndex * cellIndex, void * data)
+{
+    menu_cell_basic_draw(ctx, cellLayer, summaryTitles[cellIndex->row], summaryValues[cellIndex->row], NULL);
 }
 
 static void onSummaryMenuWindowLoad(Window * window)
 {
+    readLastWorkout();
+    updateSummary();
+
     // Now we prepare to initialize the menu layer
     Layer * windowRootLayer = window_get_root_layer(window);
     const GRect bounds = layer_get_frame(windowRootLayer);
@@ -454,9 +922,17 @@ static void initSummaryMenuWindow()
                                });
 }
 
+static void pushSummaryMenuWindow()
+{
+    if (!summaryMenuWindow) initSummaryMenuWindow();
+    pushWindow(summaryMenuWindow, true);
+}
+
 static void deinitSummaryMenuWindow()
 {
+    if (!summaryMenuWindow) return;
     window_destroy(summaryMenuWindow);
+    summaryMenuWindow = NULL;
 }
 
 //
@@ -499,12 +975,20 @@ static void onMainMenuDrawHeader(GContext * ctx, const Layer * cellLayer, uint16
 
 static void onMainMenuDrawRow(GContext* ctx, const Layer * cellLayer, MenuIndex * cellIndex, void * data)
 {
+    firstFrameDrawn();
+
     switch (cellIndex->section) {
     case 0:
         switch (cellIndex->row) {
         case 0: {
-            char str[12];
-            snprintf(str, 12, "%d (%dm)", desiredLaneCount, desiredLaneCount*lengthOfLane);
+            // with intervals the schedule decides the lanes
+            char str[24];
+            if (intervalTemplate > 0) {
+                const int laneCount = Interval_laneCount(&intervalTemplates[intervalTemplate - 1]);
+                snprintf(str, sizeof(str), "%d (%dm) by intervals", laneCount, laneCount*lengthOfLane);
+            } else {
+                snprintf(str, sizeof(str), "%d (%dm)", desiredLaneCount, desiredLaneCount*lengthOfLane);
+            }
             menu_cell_basic_draw(ctx, cellLayer, "Desired lanes", str, NULL);
             break;
         }
@@ -515,6 +999,15 @@ static void onMainMenuDrawRow(GContext* ctx, const Layer * cellLayer, MenuIndex
             break;
         }
         case 2:
+            if (intervalTemplate > 0) {
+                char str[32];
+                Interval_format(&intervalTemplates[intervalTemplate - 1], str, sizeof(str));
+                menu_cell_basic_draw(ctx, cellLayer, "Intervals", str, NULL);
+            } else {
+                menu_cell_basic_draw(ctx, cellLayer, "Intervals", "Off, uniform pace", NULL);
+            }
+            break;
+        case 3:
             menu_cell_basic_draw(ctx, cellLayer, "Start", NULL, NULL);
             break;
         }
@@ -535,6 +1028,20 @@ static void onMainMenuDrawRow(GContext* ctx, const Layer * cellLayer, MenuIndex
             menu_cell_basic_draw(ctx, cellLayer, "Length of lane", str, NULL);
             break;
         }
+        case 1:
+            menu_cell_basic_draw(ctx, cellLayer, "Auto lane", autoLane ? "On, detects push-offs" : "Off", NULL);
+            break;
+        case 2:
+            menu_cell_basic_draw(ctx, cellLayer, "Countdown", countdownCues[countdownCue].name, NULL);
+            break;
+#if PERF_COUNTERS
+        case 3: {
+            char str[48];
+            PerfCounters_format(str, sizeof(str));
+            menu_cell_basic_draw(ctx, cellLayer, "Perf counters", str, NULL);
+            break;
+        }
+#endif
         }
         break;
     }
@@ -546,22 +1053,28 @@ static void onMainMenuMenuSelect(MenuLayer * menuLayer, MenuIndex * cellIndex, v
     case 0:
         switch (cellIndex->row) {
         case 0:
+            if (intervalTemplate > 0) break;
             currentValueToChange = &desiredLaneCount;
-            action_bar_layer_add_to_window(actionBarLayer, mainMenuWindow);
+            showActionBar();
             break;
         case 1:
             currentValueToChange = &timePerLane;
-            action_bar_layer_add_to_window(actionBarLayer, mainMenuWindow);
+            showActionBar();
             break;
         case 2:
-            window_stack_push(digitWindow, true);
+            intervalTemplate = (intervalTemplate + 1) % (NUM_INTERVAL_TEMPLATES + 1);
+            Persistence_flush();
+            layer_mark_dirty(menu_layer_get_layer(menuLayer));
+            break;
+        case 3:
+            pushDigitWindow(true);
             break;
         }
         break;
     case 1:
         switch (cellIndex->row) {
         case 0:
-            window_stack_push(summaryMenuWindow, true);
+            pushSummaryMenuWindow();
             break;
         }
         break;
@@ -570,6 +1083,17 @@ static void onMainMenuMenuSelect(MenuLayer * menuLayer, MenuIndex * cellIndex, v
         case 0:
             if (lengthOfLane == 25) lengthOfLane = 50;
             else                    lengthOfLane = 25;
+            Persistence_flush();
+            layer_mark_dirty(menu_layer_get_layer(menuLayer));
+            break;
+        case 1:
+            autoLane = !autoLane;
+            Persistence_flush();
+            layer_mark_dirty(menu_layer_get_layer(menuLayer));
+            break;
+        case 2:
+            countdownCue = (countdownCue + 1) % NUM_COUNTDOWN_CUES;
+            Persistence_flush();
             layer_mark_dirty(menu_layer_get_layer(menuLayer));
             break;
         }
@@ -583,6 +1107,7 @@ static void onMainMenuMenuSelect(MenuLayer * menuLayer, MenuIndex * cellIndex, v
 static void onActionBarLayerBackClicked(ClickRecognizerRef recognizer, void * context)
 {
     currentValueToChange = NULL;
+    Persistence_flush();
     action_bar_layer_remove_from_window(actionBarLayer);
     setClickContextProviderForMainMenu(mainMenuLayer, mainMenuWindow);
 }
@@ -611,6 +1136,25 @@ static void actionBarLayerClickConfigProvider(void * context)
     window_single_repeating_click_subscribe(BUTTON_ID_DOWN, 200, (ClickHandler)onActionBarLayerDownClicked);
 }
 
+// The action bar only shows while a value is changed, so it and its icons are
+// created the first time that happens.
+static void showActionBar()
+{
+    if (!actionBarLayer) {
+        iconUp   = ResourceCache_acquire(RESOURCE_ID_IMAGE_ACTION_ICON_UP);
+        iconOK   = ResourceCache_acquire(RESOURCE_ID_IMAGE_ACTION_ICON_OK);
+        iconDown = ResourceCache_acquire(RESOURCE_ID_IMAGE_ACTION_ICON_DOWN);
+
+        actionBarLayer = action_bar_layer_create();
+        action_bar_layer_set_click_config_provider(actionBarLayer, actionBarLayerClickConfigProvider);
+
+        action_bar_layer_set_icon_animated(actionBarLayer, BUTTON_ID_UP,     iconUp,   true);
+        action_bar_layer_set_icon_animated(actionBarLayer, BUTTON_ID_SELECT, iconOK,   true);
+        action_bar_layer_set_icon_animated(actionBarLayer, BUTTON_ID_DOWN,   iconDown, true);
+    }
+    action_bar_layer_add_to_window(actionBarLayer, mainMenuWindow);
+}
+
 //
 // main window
 
@@ -665,14 +1209,6 @@ static void onMainMenuWindowLoad(Window * window)
     setClickContextProviderForMainMenu(mainMenuLayer, window);
 
     layer_add_child(windowRootLayer, menu_layer_get_layer(mainMenuLayer));
-
-    // Initialize the action bar:
-    actionBarLayer = action_bar_layer_create();
-    action_bar_layer_set_click_config_provider(actionBarLayer, actionBarLayerClickConfigProvider);
-
-    action_bar_layer_set_icon_animated(actionBarLayer, BUTTON_ID_UP,     iconUp,   true);
-    action_bar_layer_set_icon_animated(actionBarLayer, BUTTON_ID_SELECT, iconOK,   true);
-    action_bar_layer_set_icon_animated(actionBarLayer, BUTTON_ID_DOWN,   iconDown, true);
 }
 
 static void onMainMenuWindowUnload(Window * window)
@@ -680,8 +1216,17 @@ static void onMainMenuWindowUnload(Window * window)
     menu_layer_destroy(mainMenuLayer);
     mainMenuLayer = NULL;
 
-    action_bar_layer_destroy(actionBarLayer);
-    actionBarLayer = NULL;
+    if (actionBarLayer) {
+        action_bar_layer_destroy(actionBarLayer);
+        actionBarLayer = NULL;
+
+        ResourceCache_release(iconUp);
+        ResourceCache_release(iconOK);
+        ResourceCache_release(iconDown);
+        iconUp   = NULL;
+        iconOK   = NULL;
+        iconDown = NULL;
+    }
 }
 
 static void initMainMenuWindow()
@@ -691,7 +1236,7 @@ static void initMainMenuWindow()
                                    .load   = onMainMenuWindowLoad,
                                    .unload = onMainMenuWindowUnload,
                                });
-    window_stack_push(mainMenuWindow, true);
+    pushWindow(mainMenuWindow, true);
 }
 
 static void deinitMainMenuWindow()
@@ -699,72 +1244,185 @@ static void deinitMainMenuWindow()
     window_destroy(mainMenuWindow);
 }
 
+static void readPersistentSettings()
+{
+    Persistence_registerInt(PERSIST_KEY_DESIRED_LANE_COUNT, &desiredLaneCount);
+    Persistence_registerInt(PERSIST_KEY_TIME_PER_LANE,      &timePerLane);
+    Persistence_registerInt(PERSIST_KEY_LENGTH_OF_LANE,     &lengthOfLane);
+    Persistence_registerInt(PERSIST_KEY_AUTO_LANE,          &autoLane);
+    Persistence_registerInt(PERSIST_KEY_INTERVAL_TEMPLATE,  &intervalTemplate);
+    if (intervalTemplate > NUM_INTERVAL_TEMPLATES) intervalTemplate = 0;
+    Persistence_registerInt(PERSIST_KEY_COUNTDOWN_CUE,      &countdownCue);
+    if (countdownCue < 0 || countdownCue >= NUM_COUNTDOWN_CUES) countdownCue = 0;
+
+    // all templates in one key, the built-in ones are stored on the first launch
+    PERF_COUNT(PERF_PERSIST_READS);
+    if (persist_get_size(PERSIST_KEY_INTERVAL_TEMPLATES) == sizeof(intervalTemplates)) {
+        persist_read_data(PERSIST_KEY_INTERVAL_TEMPLATES, intervalTemplates, sizeof(intervalTemplates));
+    } else {
+        persist_write_data(PERSIST_KEY_INTERVAL_TEMPLATES, intervalTemplates, sizeof(intervalTemplates));
+        PERF_COUNT(PERF_PERSIST_WRITES);
+    }
+}
+
 #define readPersistInt(key, variable) \
-    do { if (persist_exists(key)) variable = persist_read_int(key); } while (0)
+    do { PERF_COUNT(PERF_PERSIST_READS); if (persist_exists(key)) variable = persist_read_int(key); } while (0)
 
-static void readPersistentSettings()
+// moves the single last workout of older versions into the history
+static void migrateLastWorkout()
 {
-    readPersistInt(PERSIST_KEY_DESIRED_LANE_COUNT,            desiredLaneCount);
-    readPersistInt(PERSIST_KEY_TIME_PER_LANE,                 timePerLane);
-    readPersistInt(PERSIST_KEY_LENGTH_OF_LANE,                lengthOfLane);
-    readPersistInt(PERSIST_KEY_LAST_WORKOUT_LENGTH_OF_LANE,   lastWorkoutLengthOfLane);
-    readPersistInt(PERSIST_KEY_LAST_WORKOUT_LANE_COUNT,       lastWorkoutLaneCount);
-    readPersistInt(PERSIST_KEY_LAST_WORKOUT_START_OF_WORKOUT, lastWorkoutStartTimeOfWorkout);
-    readPersistInt(PERSIST_KEY_LAST_WORKOUT_CUMULATIVE_PAUSE, lastWorkoutCumulatedPauseTimeOfWorkout);
-    readPersistInt(PERSIST_KEY_LAST_WORKOUT_END_OF_WORKOUT,   lastWorkoutEndTimeOfWorkout);
+    PERF_COUNT(PERF_PERSIST_READS);
+    if (!persist_exists(PERSIST_KEY_LAST_WORKOUT_LANE_COUNT) || History_count() > 0) return;
+
+    HistoryRecord record = { 0 };
+    readPersistInt(PERSIST_KEY_LAST_WORKOUT_LENGTH_OF_LANE,   record.lengthOfLane);
+    readPersistInt(PERSIST_KEY_LAST_WORKOUT_LANE_COUNT,       record.laneCount);
+    readPersistInt(PERSIST_KEY_LAST_WORKOUT_START_OF_WORKOUT, record.startTime);
+    readPersistInt(PERSIST_KEY_LAST_WORKOUT_CUMULATIVE_PAUSE, record.pauseTime);
+    readPersistInt(PERSIST_KEY_LAST_WORKOUT_END_OF_WORKOUT,   record.endTime);
+    History_add(&record);
+
+    for (uint32_t key = PERSIST_KEY_LAST_WORKOUT_LENGTH_OF_LANE; key <= PERSIST_KEY_LAST_WORKOUT_END_OF_WORKOUT; ++key) {
+        persist_delete(key);
+        PERF_COUNT(PERF_PERSIST_WRITES);
+    }
 }
 
-static void writePersistentSettings()
+// the encoded splits as stored from firstKey on
+static int readEncodedSplits(uint32_t firstKey, uint8_t * buffer, size_t capacity)
 {
-    persist_write_int(PERSIST_KEY_DESIRED_LANE_COUNT,            desiredLaneCount);
-    persist_write_int(PERSIST_KEY_TIME_PER_LANE,                 timePerLane);
-    persist_write_int(PERSIST_KEY_LENGTH_OF_LANE,                lengthOfLane);
-    persist_write_int(PERSIST_KEY_LAST_WORKOUT_LENGTH_OF_LANE,   lastWorkoutLengthOfLane);
-    persist_write_int(PERSIST_KEY_LAST_WORKOUT_LANE_COUNT,       lastWorkoutLaneCount);
-    persist_write_int(PERSIST_KEY_LAST_WORKOUT_START_OF_WORKOUT, lastWorkoutStartTimeOfWorkout);
-    persist_write_int(PERSIST_KEY_LAST_WORKOUT_CUMULATIVE_PAUSE, lastWorkoutCumulatedPauseTimeOfWorkout);
-    persist_write_int(PERSIST_KEY_LAST_WORKOUT_END_OF_WORKOUT,   lastWorkoutEndTimeOfWorkout);
+    size_t size = 0;
+    for (int i = 0; i < NUM_SPLITS_PERSIST_KEYS && size < capacity; ++i) {
+        const size_t left = capacity - size;
+        const int read = persist_read_data(firstKey + i, buffer + size,
+                                           left < PERSIST_DATA_MAX_LENGTH ? left : PERSIST_DATA_MAX_LENGTH);
+        PERF_COUNT(PERF_PERSIST_READS);
+        if (read <= 0) break;
+        size += read;
+    }
+    return size;
 }
 
-static void initIcons()
+// the splits of the last workout, also sent to the phone as they are
+static int readEncodedLastWorkoutSplits(uint8_t * buffer, size_t capacity)
 {
-    iconUp    = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_ACTION_ICON_UP);
-    iconOK    = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_ACTION_ICON_OK);
-    iconDown  = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_ACTION_ICON_DOWN);
-    iconPlay  = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_ACTION_ICON_PLAY);
-    iconPause = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_ACTION_ICON_PAUSE);
+    return readEncodedSplits(PERSIST_KEY_LAST_WORKOUT_SPLITS, buffer, capacity);
 }
 
-static void deinitIcons()
+static void readLastWorkout()
 {
-    gbitmap_destroy(iconUp);
-    gbitmap_destroy(iconOK);
-    gbitmap_destroy(iconDown);
-    gbitmap_destroy(iconPlay);
-    gbitmap_destroy(iconPause);
+    // after a workout, the one in memory is the last one
+    if (lastWorkoutRead) return;
+    lastWorkoutRead = true;
+
+    PERF_COUNT(PERF_PERSIST_READS);
+    if (persist_read_data(PERSIST_KEY_LAST_WORKOUT_STATS, &workoutStats, sizeof(workoutStats)) != sizeof(workoutStats)) {
+        WorkoutStats_reset(&workoutStats, 0);
+    }
+
+    History_get(0, &lastWorkout);
+}
+
+static void writeEncodedSplits(uint32_t firstKey, int target)
+{
+    const int capacity = NUM_SPLITS_PERSIST_KEYS * PERSIST_DATA_MAX_LENGTH;
+    uint8_t * buffer = malloc(capacity);
+    if (!buffer) return;
+
+    // merge older lanes until the workout fits into the persist keys
+    int size = LaneSplits_encode(&laneSplits, target, buffer, capacity);
+    while (size < 0) {
+        const uint16_t count = laneSplits.count;
+        LaneSplits_downsample(&laneSplits);
+        if (laneSplits.count == count) break;
+        size = LaneSplits_encode(&laneSplits, target, buffer, capacity);
+    }
+
+    for (int i = 0; i < NUM_SPLITS_PERSIST_KEYS; ++i) {
+        const int offset = i * PERSIST_DATA_MAX_LENGTH;
+        if (offset < size) {
+            const int length = size - offset < PERSIST_DATA_MAX_LENGTH ? size - offset : PERSIST_DATA_MAX_LENGTH;
+            persist_write_data(firstKey + i, buffer + offset, length);
+        } else {
+            persist_delete(firstKey + i);
+        }
+        PERF_COUNT(PERF_PERSIST_WRITES);
+    }
 
-    iconUp    = NULL;
-    iconOK    = NULL;
-    iconDown  = NULL;
-    iconPlay  = NULL;
-    iconPause = NULL;
+    free(buffer);
+}
+
+#if PERF_COUNTERS
+static time_t startupSeconds;
+static uint16_t startupMs;
+#endif
+static bool startupDeferred = false;
+
+// The rest of the startup, run by a timer registered while the first frame is
+// drawn, so it runs once that frame is on the screen.
+static void finishStartup(void * data)
+{
+    migrateLastWorkout();
+    Sync_init(readEncodedLastWorkoutSplits);
+}
+
+static void deferStartup()
+{
+    if (startupDeferred) return;
+    startupDeferred = true;
+    app_timer_register(0, finishStartup, NULL);
+}
+
+// called while the main menu is drawn, only the first time counts
+static void firstFrameDrawn()
+{
+    if (startupDeferred) return;
+
+#if PERF_COUNTERS
+    time_t seconds;
+    uint16_t ms;
+    time_ms(&seconds, &ms);
+    const int firstFrameMs = (seconds - startupSeconds) * 1000 + ms - startupMs;
+    const int heapUsed = heap_bytes_used();
+    PERF_ADD(PERF_FIRST_FRAME_MS, firstFrameMs);
+    PERF_ADD(PERF_BASELINE_HEAP, heapUsed);
+    APP_LOG(APP_LOG_LEVEL_INFO, "First frame after %d ms, %d bytes of heap used", firstFrameMs, heapUsed);
+#endif
+
+    deferStartup();
 }
 
 int main(void)
 {
-    readPersistentSettings();
-    initIcons();
+#if PERF_COUNTERS
+    time_ms(&startupSeconds, &startupMs);
+#endif
 
+    // only what the first screen needs, the other windows are created when
+    // they are pushed and the last workout when the summary is opened
+    readPersistentSettings();
     initMainMenuWindow();
-    initDigitWindow();
-    initSummaryMenuWindow();
+
+    // jump back into a workout that was interrupted
+    if (readWorkoutCheckpoint()) {
+        resumeWorkout = true;
+        pushDigitWindow(false);
+
+        // the digit window draws nothing of its own to wait for, and the
+        // workout needs the rest of the startup before the main menu is shown
+        deferStartup();
+    }
 
     app_event_loop();
 
+    Sync_deinit();
+    deinitMessageBox();
     deinitSummaryMenuWindow();
     deinitDigitWindow();
     deinitMainMenuWindow();
 
-    deinitIcons();
-    writePersistentSettings();
+    // the bitmaps kept for the next use outlive the windows
+    ResourceCache_evictUnused();
+
+    Persistence_flush();
 }
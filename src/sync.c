@@ -0,0 +1,271 @@
+#include "sync.h"
+#include "history.h"
+
+#define RETRY_DELAY_MS 1000
+#define ACK_TIMEOUT_MS 10000 // longer than a lost frame takes to fail
+#define MAX_RETRIES    5
+
+static SyncSplitsReader readSplits = NULL;
+static uint32_t payloadSize = 0;
+
+typedef struct {
+    bool     active;
+    uint16_t nextId;       // first workout not acked yet
+    uint16_t lastSentId;   // last workout of the frame in flight
+    bool     splitsPending;
+    bool     splitsInFlight;
+    bool     doneInFlight;  // not acked, the sync ends once the phone got it
+    uint8_t  retries;
+    uint32_t recordsSent;
+    time_t   startSeconds;
+    uint16_t startMs;
+} SyncState;
+
+static SyncState state;
+
+static AppTimer * retryTimer = NULL;
+static AppTimer * ackTimer = NULL;
+
+static int ageOf(uint16_t id)
+{
+    return (uint16_t)(History_id(0) - id);
+}
+
+static void logThroughput()
+{
+    time_t seconds;
+    uint16_t ms;
+    time_ms(&seconds, &ms);
+    const int32_t elapsed = (int32_t)(seconds - state.startSeconds) * 1000 + ms - state.startMs;
+
+    APP_LOG(APP_LOG_LEVEL_INFO, "Sync: %d records in %d ms, %d records/s", (int)state.recordsSent, (int)elapsed,
+            elapsed > 0 ? (int)(state.recordsSent * 1000 / elapsed) : 0);
+}
+
+static bool sendCommand(uint8_t command, int32_t id)
+{
+    DictionaryIterator * iter;
+    if (app_message_outbox_begin(&iter) != APP_MSG_OK) return false;
+
+    dict_write_int32(iter, SYNC_KEY_COMMAND, command);
+    dict_write_int32(iter, SYNC_KEY_ID, id);
+    dict_write_end(iter);
+    return app_message_outbox_send() == APP_MSG_OK;
+}
+
+static bool sendRecords()
+{
+    // oldest first, as many as fit into one frame
+    const int count = ageOf(state.nextId) + 1;
+    const int perFrame = payloadSize / sizeof(HistoryRecord);
+    const int frameCount = count < perFrame ? count : perFrame;
+
+    HistoryRecord * records = malloc(frameCount * sizeof(HistoryRecord));
+    if (!records) return false;
+
+    DictionaryIterator * iter;
+    if (app_message_outbox_begin(&iter) != APP_MSG_OK) {
+        free(records);
+        return false;
+    }
+
+    for (int i = 0; i < frameCount; ++i) {
+        if (!History_get(ageOf(state.nextId + i), &records[i])) memset(&records[i], 0, sizeof(records[i]));
+    }
+
+    dict_write_int32(iter, SYNC_KEY_COMMAND, SYNC_CMD_RECORDS);
+    dict_write_int32(iter, SYNC_KEY_ID, state.nextId);
+    dict_write_int32(iter, SYNC_KEY_COUNT, frameCount);
+    dict_write_data(iter, SYNC_KEY_PAYLOAD, (const uint8_t *)records, frameCount * sizeof(HistoryRecord));
+    dict_write_end(iter);
+    free(records);
+
+    state.lastSentId = state.nextId + frameCount - 1;
+    state.recordsSent += frameCount;
+    return app_message_outbox_send() == APP_MSG_OK;
+}
+
+static bool sendSplits()
+{
+    DictionaryIterator * iter;
+    if (app_message_outbox_begin(&iter) != APP_MSG_OK) return false;
+
+    uint8_t * buffer = malloc(payloadSize);
+    const int size = buffer ? readSplits(buffer, payloadSize) : 0;
+
+    dict_write_int32(iter, SYNC_KEY_COMMAND, SYNC_CMD_SPLITS);
+    dict_write_int32(iter, SYNC_KEY_ID, History_id(0));
+    dict_write_data(iter, SYNC_KEY_PAYLOAD, buffer, size > 0 ? size : 0);
+    dict_write_end(iter);
+    free(buffer);
+
+    state.lastSentId = History_id(0);
+    state.splitsInFlight = true;
+    return app_message_outbox_send() == APP_MSG_OK;
+}
+
+static void cancelTimers()
+{
+    if (retryTimer) app_timer_cancel(retryTimer);
+    if (ackTimer)   app_timer_cancel(ackTimer);
+    retryTimer = NULL;
+    ackTimer   = NULL;
+}
+
+static void onRetryTimer(void * data);
+static void onAckTimeout(void * data);
+
+// the same frame again after a while, the phone didn't get it or its ack got lost
+static void scheduleRetry()
+{
+    if (ackTimer) app_timer_cancel(ackTimer);
+    ackTimer = NULL;
+    state.splitsInFlight = false;
+    state.doneInFlight   = false;
+    if (!retryTimer) retryTimer = app_timer_register(RETRY_DELAY_MS, onRetryTimer, NULL);
+}
+
+// sends the next frame, or tells the phone that everything is there
+static void sendNext()
+{
+    if (!state.active) return;
+
+    bool sent;
+    if (History_count() > 0 && ageOf(state.nextId) < History_count()) {
+        sent = sendRecords();
+    } else if (state.splitsPending) {
+        sent = sendSplits();
+    } else {
+        sent = sendCommand(SYNC_CMD_DONE, History_count() > 0 ? History_id(0) : -1);
+        state.doneInFlight = sent;
+    }
+
+    // the outbox may still be busy, or the phone gone
+    if (!sent) {
+        scheduleRetry();
+    } else if (!ackTimer && !state.doneInFlight) {
+        ackTimer = app_timer_register(ACK_TIMEOUT_MS, onAckTimeout, NULL);
+    }
+}
+
+static void onRetryTimer(void * data)
+{
+    retryTimer = NULL;
+    if (++state.retries > MAX_RETRIES) {
+        APP_LOG(APP_LOG_LEVEL_WARNING, "Sync: giving up at workout %d", state.nextId);
+        state.active = false;
+        return;
+    }
+    sendNext();
+}
+
+static void onAckTimeout(void * data)
+{
+    ackTimer = NULL;
+    if (state.active) scheduleRetry();
+}
+
+static void startSync(int32_t ackedId, int32_t splitsId)
+{
+    cancelTimers();
+    state = (SyncState){ .active = true };
+    time_ms(&state.startSeconds, &state.startMs);
+
+    const int count = History_count();
+    if (ackedId < 0 || ageOf(ackedId) >= count) {
+        // the phone has none of the stored workouts
+        state.nextId = History_id(count - 1);
+    } else {
+        state.nextId = ackedId + 1;
+    }
+
+    // the splits belong to the latest workout, the phone may have its record but not them
+    state.splitsPending = count > 0 && splitsId != History_id(0);
+    sendNext();
+}
+
+// an ack of the other kind of frame, or a late one of an earlier frame, doesn't count
+static void onAck(int32_t ackedId, bool splits)
+{
+    if (!state.active || state.doneInFlight || splits != state.splitsInFlight || ackedId != state.lastSentId) return;
+
+    cancelTimers();
+    state.retries = 0;
+    if (splits) {
+        state.splitsInFlight = false;
+        state.splitsPending  = false;
+    } else {
+        state.nextId = state.lastSentId + 1;
+    }
+    sendNext();
+}
+
+static void onInboxReceived(DictionaryIterator * iter, void * context)
+{
+    const Tuple * command  = dict_find(iter, SYNC_KEY_COMMAND);
+    const Tuple * id       = dict_find(iter, SYNC_KEY_ID);
+    const Tuple * splitsId = dict_find(iter, SYNC_KEY_SPLITS_ID);
+    if (!command || !id) return;
+
+    switch (command->value->int32) {
+    case SYNC_CMD_REQUEST:
+        // phones that don't tell have the splits of the workouts they acked
+        startSync(id->value->int32, splitsId ? splitsId->value->int32 : id->value->int32);
+        break;
+    case SYNC_CMD_ACK:
+        onAck(id->value->int32, false);
+        break;
+    case SYNC_CMD_SPLITS_ACK:
+        onAck(id->value->int32, true);
+        break;
+    }
+}
+
+static void onOutboxSent(DictionaryIterator * iter, void * context)
+{
+    if (!state.active || !state.doneInFlight) return;
+
+    cancelTimers();
+    state.active = false;
+    logThroughput();
+}
+
+static void onOutboxFailed(DictionaryIterator * iter, AppMessageResult reason, void * context)
+{
+    if (state.active) scheduleRetry();
+}
+
+void Sync_announce()
+{
+    sendCommand(SYNC_CMD_HELLO, History_count() > 0 ? History_id(0) : -1);
+}
+
+static void onConnection(bool connected)
+{
+    // the phone resumes from what it acked last
+    if (connected) Sync_announce();
+}
+
+void Sync_init(SyncSplitsReader splitsReader)
+{
+    readSplits = splitsReader;
+
+    uint32_t outboxSize = app_message_outbox_size_maximum();
+    if (outboxSize > SYNC_OUTBOX_SIZE) outboxSize = SYNC_OUTBOX_SIZE;
+    payloadSize = outboxSize - dict_calc_buffer_size(4, sizeof(int32_t), sizeof(int32_t), sizeof(int32_t), 0);
+
+    app_message_register_inbox_received(onInboxReceived);
+    app_message_register_outbox_sent(onOutboxSent);
+    app_message_register_outbox_failed(onOutboxFailed);
+    app_message_open(64, outboxSize);
+
+    // at start the phone sends its request by itself
+    connection_service_subscribe((ConnectionHandlers){ .pebble_app_connection_handler = onConnection });
+}
+
+void Sync_deinit()
+{
+    connection_service_unsubscribe();
+    cancelTimers();
+    app_message_deregister_callbacks();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "pebble.h"
+
+// AppMessage keys, see appKeys in appinfo.json
+#define SYNC_KEY_COMMAND   0
+#define SYNC_KEY_ID        1
+#define SYNC_KEY_COUNT     2
+#define SYNC_KEY_PAYLOAD   3
+#define SYNC_KEY_SPLITS_ID 4
+
+// commands, from the phone
+#define SYNC_CMD_REQUEST    1 // send the workouts after SYNC_KEY_ID, -1 for all, and the
+                              // latest splits unless they are of SYNC_KEY_SPLITS_ID
+#define SYNC_CMD_ACK        2 // workouts up to SYNC_KEY_ID are stored
+#define SYNC_CMD_SPLITS_ACK 7 // the splits of workout SYNC_KEY_ID are stored
+// commands, from the watch
+#define SYNC_CMD_HELLO      3 // the watch is ready, please send a request
+#define SYNC_CMD_RECORDS    4 // SYNC_KEY_COUNT history records, the first one has SYNC_KEY_ID
+#define SYNC_CMD_SPLITS     5 // encoded lane splits of workout SYNC_KEY_ID
+#define SYNC_CMD_DONE       6 // everything is sent, SYNC_KEY_ID is the latest workout
+
+// the outbox is at most this large, so frames stay below it
+#define SYNC_OUTBOX_SIZE 640
+
+/*
+ * Reads the encoded lane splits of the latest workout, returns their size or
+ * 0 if there are none.
+ */
+typedef int (*SyncSplitsReader)(uint8_t * buffer, size_t size);
+
+/*
+ * Streams the history to the phone. The phone tells which workout it stored
+ * last, only the ones after it are sent, as many per frame as fit into the
+ * outbox. It tells the splits it stored apart, so splits lost with the link
+ * are sent on the next sync. Each frame waits for the phone's ack; a failed
+ * frame or one not acked in time is sent again, and after a disconnect the
+ * sync resumes from the last acked workout.
+ */
+void Sync_init(SyncSplitsReader splitsReader);
+void Sync_deinit();
+
+/*
+ * Asks the phone to sync, after a workout was added
+ */
+void Sync_announce();
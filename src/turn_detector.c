@@ -0,0 +1,53 @@
+#include "turn_detector.h"
+
+// baseline follows the energy with a weight of 1/16 per sample
+#define BASELINE_SHIFT 4
+
+// energy is the squared magnitude in mG^2 / 256, 1g at rest is 3906. Hard
+// strokes get past 16000 above the baseline, some weak push-offs stay below 24000;
+// tuned with bench/turn_detector_bench.c.
+#define DEFAULT_THRESHOLD 19000
+
+// a push-off peaks within 40ms at 25Hz, longer bursts miss the weak ones
+#define DEFAULT_BURST_SAMPLES 1
+
+void TurnDetector_init(TurnDetector * detector, uint16_t samplingRate, uint16_t minLaneSeconds)
+{
+    *detector = (TurnDetector){
+        .threshold         = DEFAULT_THRESHOLD,
+        .minBurstSamples   = DEFAULT_BURST_SAMPLES * samplingRate / 25 > 0 ? DEFAULT_BURST_SAMPLES * samplingRate / 25 : 1,
+        .refractorySamples = (uint32_t)samplingRate * minLaneSeconds,
+        .baseline          = 3906 << BASELINE_SHIFT,
+    };
+}
+
+void TurnDetector_laneStarted(TurnDetector * detector)
+{
+    detector->burstSamples = 0;
+    detector->samplesSinceLaneStart = 0;
+}
+
+bool TurnDetector_addSample(TurnDetector * detector, int16_t x, int16_t y, int16_t z)
+{
+    const int32_t energy = ((int32_t)x * x + (int32_t)y * y + (int32_t)z * z) >> 8;
+    const int32_t activity = energy - (detector->baseline >> BASELINE_SHIFT);
+
+    // bursts would drag the baseline up, so they don't count into it
+    if (activity > detector->threshold) {
+        ++detector->burstSamples;
+    } else {
+        detector->burstSamples = 0;
+        detector->baseline += energy - (detector->baseline >> BASELINE_SHIFT);
+    }
+
+    if (detector->samplesSinceLaneStart < detector->refractorySamples) {
+        ++detector->samplesSinceLaneStart;
+        return false;
+    }
+
+    if (detector->burstSamples == detector->minBurstSamples) {
+        TurnDetector_laneStarted(detector);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Plain C without any SDK calls, so it runs unchanged on recorded traces.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Streaming push-off detector on accelerometer samples (mG). A push-off from
+ * the wall shows as a short burst of acceleration well above the running
+ * baseline. Integer math only, constant time and memory per sample.
+ */
+typedef struct {
+    // configuration
+    int32_t  threshold;         // energy above the baseline that counts as push-off
+    uint16_t minBurstSamples;   // consecutive samples above the threshold
+    uint32_t refractorySamples; // samples after a lane start without detection
+
+    // state
+    int32_t  baseline;          // running average of the energy, << BASELINE_SHIFT
+    uint16_t burstSamples;
+    uint32_t samplesSinceLaneStart;
+} TurnDetector;
+
+void TurnDetector_init(TurnDetector * detector, uint16_t samplingRate, uint16_t minLaneSeconds);
+
+/*
+ * Tells the detector that a lane started, e.g. because of a button press
+ */
+void TurnDetector_laneStarted(TurnDetector * detector);
+
+/*
+ * Feeds one sample, returns true if it completes a push-off
+ */
+bool TurnDetector_addSample(TurnDetector * detector, int16_t x, int16_t y, int16_t z);
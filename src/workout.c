@@ -0,0 +1,195 @@
+#include "workout.h"
+
+#include <stddef.h>
+
+// the time of the current lane, or of the rest after it
+static int32_t targetTime(const WorkoutState * workout, const IntervalSchedule * schedule)
+{
+    if (!schedule || workout->laneCount < 1 || workout->laneCount > schedule->laneCount) return workout->timePerLane;
+
+    const IntervalLane * lane = &schedule->lanes[workout->laneCount - 1];
+    return (workout->resting ? lane->rest : lane->timePerLane) * 1000;
+}
+
+static bool restAfterCurrentLane(const WorkoutState * workout, const IntervalSchedule * schedule)
+{
+    if (!schedule || workout->laneCount < 1 || workout->laneCount > schedule->laneCount) return 0;
+
+    return schedule->lanes[workout->laneCount - 1].rest > 0;
+}
+
+static uint8_t finishLane(WorkoutState * workout, WorkoutClock now);
+static uint8_t startNextLane(WorkoutState * workout, const IntervalSchedule * schedule, WorkoutClock now);
+
+static void startLane(WorkoutState * workout, const IntervalSchedule * schedule, WorkoutClock now)
+{
+    workout->startTimeOfCurrentLane = now;
+    workout->cumulatedPauseTimeOfCurrentLane = 0;
+
+    if (Workout_isPaused(workout)) {
+        workout->startTimeOfCurrentPause = now;
+    } else {
+        workout->virtualEndTimeOfCurrentLane = workout->startTimeOfCurrentLane + targetTime(workout, schedule);
+    }
+}
+
+// The rest counts as pause of the workout, so it doesn't slow the pace down.
+// Pauses within the rest were already counted when they ended.
+static void countRestAsPause(WorkoutState * workout, WorkoutClock now)
+{
+    workout->cumulatedPauseTimeOfWorkout += now - workout->startTimeOfCurrentLane - workout->cumulatedPauseTimeOfCurrentLane;
+}
+
+void Workout_start(WorkoutState * workout, time_t seconds, uint16_t ms, int32_t timePerLane, int desiredLaneCount,
+                   const IntervalSchedule * schedule)
+{
+    *workout = (WorkoutState){
+        .desiredLaneCount   = desiredLaneCount,
+        .timePerLane        = timePerLane,
+        .startTimeOfWorkout = seconds,
+        .startMsOfWorkout   = ms,
+        .timeOfPreviousLane = timePerLane,
+    };
+    if (schedule && schedule->laneCount > 0) workout->desiredLaneCount = schedule->laneCount;
+    startNextLane(workout, schedule, 0);
+}
+
+WorkoutClock Workout_clock(const WorkoutState * workout, time_t seconds, uint16_t ms)
+{
+    return (WorkoutClock)(seconds - (time_t)workout->startTimeOfWorkout) * 1000 + ((int)ms - workout->startMsOfWorkout);
+}
+
+bool Workout_isPaused(const WorkoutState * workout)
+{
+    return workout->paused;
+}
+
+bool Workout_isResting(const WorkoutState * workout)
+{
+    return workout->resting;
+}
+
+static uint8_t setPaused(WorkoutState * workout, const IntervalSchedule * schedule, bool paused, WorkoutClock now)
+{
+    if (paused == Workout_isPaused(workout)) return 0;
+
+    workout->paused = paused;
+    if (paused) {
+        workout->startTimeOfCurrentPause = now;
+    } else {
+        workout->cumulatedPauseTimeOfWorkout     += now - workout->startTimeOfCurrentPause;
+        workout->cumulatedPauseTimeOfCurrentLane += now - workout->startTimeOfCurrentPause;
+
+        workout->virtualEndTimeOfCurrentLane = workout->startTimeOfCurrentLane + targetTime(workout, schedule)
+                                             + workout->cumulatedPauseTimeOfCurrentLane;
+    }
+    return WORKOUT_CHANGED;
+}
+
+int32_t Workout_remaining(const WorkoutState * workout, WorkoutClock now)
+{
+    if (Workout_isPaused(workout)) {
+        return workout->virtualEndTimeOfCurrentLane - workout->startTimeOfCurrentPause;
+    }
+    return workout->virtualEndTimeOfCurrentLane - now;
+}
+
+static uint8_t finishLane(WorkoutState * workout, WorkoutClock now)
+{
+    if (workout->resting) {
+        countRestAsPause(workout, now);
+        workout->resting = false;
+        return WORKOUT_CHANGED;
+    }
+
+    // calculate next timePerLane
+    if (Workout_isPaused(workout)) {
+        workout->cumulatedPauseTimeOfWorkout     += now - workout->startTimeOfCurrentPause;
+        workout->cumulatedPauseTimeOfCurrentLane += now - workout->startTimeOfCurrentPause;
+    }
+    if (workout->laneCount == 0) return 0;
+
+    // the next lane gets as long as this one, but not too short to swim
+    const int32_t laneTime = now - workout->startTimeOfCurrentLane - workout->cumulatedPauseTimeOfCurrentLane;
+    workout->timePerLane             = laneTime > WORKOUT_MIN_LANE_TIME ? laneTime : WORKOUT_MIN_LANE_TIME;
+    workout->timeOfPreviousLane      = laneTime > 0 ? laneTime : 0;
+    workout->pauseTimeOfPreviousLane = workout->cumulatedPauseTimeOfCurrentLane;
+    return WORKOUT_CHANGED | WORKOUT_LANE_FINISHED;
+}
+
+static uint8_t startNextLane(WorkoutState * workout, const IntervalSchedule * schedule, WorkoutClock now)
+{
+    if (!workout->resting && restAfterCurrentLane(workout, schedule)) {
+        const uint8_t result = finishLane(workout, now);
+        workout->resting = true;
+        startLane(workout, schedule, now);
+        return result | WORKOUT_CHANGED;
+    }
+
+    const uint8_t result = finishLane(workout, now);
+    if (workout->laneCount < UINT16_MAX) ++workout->laneCount;
+    startLane(workout, schedule, now);
+    return result | WORKOUT_CHANGED;
+}
+
+static uint8_t restartCurrentLane(WorkoutState * workout, const IntervalSchedule * schedule, WorkoutClock now)
+{
+    if (workout->resting) {
+        countRestAsPause(workout, now);
+        startLane(workout, schedule, now);
+        return WORKOUT_CHANGED;
+    }
+
+    const uint8_t result = finishLane(workout, now);
+    startLane(workout, schedule, now);
+    return result | WORKOUT_CHANGED;
+}
+
+static uint8_t catchUp(WorkoutState * workout, const IntervalSchedule * schedule, WorkoutClock now)
+{
+    uint8_t result = 0;
+    while (!Workout_isPaused(workout) && workout->virtualEndTimeOfCurrentLane <= now) {
+        const WorkoutClock deadline = workout->virtualEndTimeOfCurrentLane;
+        if (!workout->resting && workout->laneCount == workout->desiredLaneCount) {
+            result |= setPaused(workout, schedule, true, deadline);
+        } else {
+            result |= startNextLane(workout, schedule, deadline);
+        }
+    }
+    return result;
+}
+
+uint8_t Workout_apply(WorkoutState * workout, const IntervalSchedule * schedule, WorkoutEvent event)
+{
+    // the finished workout ends when it was finished, not at its deadlines
+    if (event.type == WORKOUT_EVENT_FINISH) return finishLane(workout, event.time);
+
+    const uint8_t result = catchUp(workout, schedule, event.time);
+    switch (event.type) {
+    case WORKOUT_EVENT_NEXT_LANE:    return result | startNextLane(workout, schedule, event.time);
+    case WORKOUT_EVENT_RESTART_LANE: return result | restartCurrentLane(workout, schedule, event.time);
+    case WORKOUT_EVENT_PAUSE:        return result | setPaused(workout, schedule, true, event.time);
+    case WORKOUT_EVENT_CONTINUE:     return result | setPaused(workout, schedule, false, event.time);
+    case WORKOUT_EVENT_CATCH_UP:     return result;
+    default:                         return result;
+    }
+}
+
+const char * Workout_checkInvariants(const WorkoutState * workout, const IntervalSchedule * schedule, WorkoutClock now)
+{
+    const int32_t laneElapsed  = now - workout->startTimeOfCurrentLane;
+    const int32_t currentPause = workout->paused ? now - workout->startTimeOfCurrentPause : 0;
+    const int32_t lanePause    = workout->cumulatedPauseTimeOfCurrentLane;
+
+    if (workout->laneCount < 1) return "no lane started";
+    if (workout->timePerLane < 1) return "lane time not positive";
+    if (workout->startTimeOfCurrentLane < 0 || laneElapsed < 0) return "lane starts outside the workout";
+    if (lanePause < 0 || currentPause < 0) return "negative pause";
+    if (lanePause > workout->cumulatedPauseTimeOfWorkout) return "lane paused longer than the workout";
+    if (workout->cumulatedPauseTimeOfWorkout + currentPause > now) return "paused longer than the workout ran";
+    if (lanePause + currentPause > laneElapsed) return "paused longer than the lane ran";
+    // while paused, the end is only known once the lane continues
+    if (!workout->paused && workout->virtualEndTimeOfCurrentLane < workout->startTimeOfCurrentLane) return "lane ends before it started";
+    if (workout->resting && (!schedule || workout->laneCount >= schedule->laneCount)) return "rest outside the schedule";
+    return NULL;
+}
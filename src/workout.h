@@ -0,0 +1,139 @@
+#pragma once
+
+// Plain C without any SDK calls, shared by the app and the background worker.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "interval.h"
+
+// persist key of the checkpoint of the running workout
+#define PERSIST_KEY_WORKOUT_CHECKPOINT 10
+
+// persist key of its IntervalSchedule, INTERVAL_SCHEDULE_SIZE bytes, written
+// once at the start; none for a workout without intervals
+#define PERSIST_KEY_WORKOUT_SCHEDULE   16
+
+// message from the app to the worker: the checkpoint was rewritten, reload it.
+// Any other message type is a WorkoutEventType, data1/data2 = workout clock of
+// the event (high/low 16 bits).
+#define WORKOUT_MSG_RELOAD 1
+
+/*
+ * Milliseconds since the start of the workout. Counting from the start keeps
+ * the times in 32 bits for more than three weeks, so sums and differences of
+ * them can't overflow within any swim.
+ */
+typedef int32_t WorkoutClock;
+
+/*
+ * The app and the worker read the workout's time only through this, which
+ * has the signature of time_ms(). Defining it at build time, e.g. to a function
+ * that advances a virtual clock, runs a workout faster than real time.
+ */
+#ifndef WORKOUT_READ_CLOCK
+#define WORKOUT_READ_CLOCK time_ms
+#endif
+
+/*
+ * Set to 1 to check the workout after every change and log broken invariants
+ */
+#ifndef WORKOUT_CHECK_INVARIANTS
+#define WORKOUT_CHECK_INVARIANTS 0
+#endif
+
+/*
+ * Shortest lane time the pace adapts to, in ms. Two quick taps would
+ * otherwise set the next deadline so close that the lanes after it run out
+ * within seconds.
+ */
+#ifndef WORKOUT_MIN_LANE_TIME
+#define WORKOUT_MIN_LANE_TIME 5000
+#endif
+
+/*
+ * State of a running workout, all times and durations on the workout clock.
+ * It is the checkpoint the worker reads, 44 bytes without padding. The
+ * schedule doesn't change during the workout and is passed in next to it.
+ * With a schedule, the lane times and rests come from it; without one, each
+ * lane takes as long as the one before.
+ * While resting, the "current lane" fields describe the rest after the lane.
+ */
+typedef struct {
+    uint32_t     startTimeOfWorkout;    // wall clock, seconds
+    uint16_t     startMsOfWorkout;      // wall clock, milliseconds within the second
+    uint16_t     laneCount;
+    uint16_t     desiredLaneCount;
+    bool         paused;
+    bool         resting;
+    int32_t      timePerLane;
+    int32_t      timeOfPreviousLane;
+    int32_t      pauseTimeOfPreviousLane;
+    WorkoutClock startTimeOfCurrentLane;
+    int32_t      cumulatedPauseTimeOfWorkout;
+    int32_t      cumulatedPauseTimeOfCurrentLane;
+    WorkoutClock startTimeOfCurrentPause;
+    WorkoutClock virtualEndTimeOfCurrentLane;
+} WorkoutState;
+
+typedef enum {
+    WORKOUT_EVENT_NEXT_LANE = 2,  // after WORKOUT_MSG_RELOAD
+    WORKOUT_EVENT_RESTART_LANE,
+    WORKOUT_EVENT_PAUSE,
+    WORKOUT_EVENT_CONTINUE,
+    WORKOUT_EVENT_CATCH_UP,       // the time passed, see Workout_apply
+    WORKOUT_EVENT_FINISH,         // the workout ends, the current lane counts
+} WorkoutEventType;
+
+typedef struct {
+    uint8_t      type;              // WorkoutEventType
+    WorkoutClock time;
+} WorkoutEvent;
+
+// result flags of Workout_apply
+#define WORKOUT_CHANGED       0x01
+#define WORKOUT_LANE_FINISHED 0x02 // times in timeOfPreviousLane and pauseTimeOfPreviousLane
+
+/*
+ * Starts a workout at the given wall clock time, which becomes 0 on the
+ * workout clock. schedule may be NULL; if given, it defines the desired lane
+ * count and the time of each lane, and the same schedule has to be passed to
+ * every call of Workout_apply.
+ */
+void Workout_start(WorkoutState * workout, time_t seconds, uint16_t ms, int32_t timePerLane, int desiredLaneCount,
+                   const IntervalSchedule * schedule);
+
+/*
+ * Converts a wall clock time, as from time_ms(), to the workout clock
+ */
+WorkoutClock Workout_clock(const WorkoutState * workout, time_t seconds, uint16_t ms);
+
+bool Workout_isPaused(const WorkoutState * workout);
+bool Workout_isResting(const WorkoutState * workout);
+
+/*
+ * Milliseconds left in the current lane or rest, frozen while paused
+ */
+int32_t Workout_remaining(const WorkoutState * workout, WorkoutClock now);
+
+/*
+ * The only way the state changes after the start; the app's screen, the
+ * worker and the summary all run the same events through it. Returns
+ * WORKOUT_* flags.
+ * If the schedule has a rest after the finished lane, NEXT_LANE begins the
+ * rest instead, and the next one (the rest's deadline or a tap to skip it)
+ * starts the lane. Restarting during a rest restarts the rest.
+ * CATCH_UP runs the lanes that ran out until the event's time, as if nobody
+ * pressed a button: each lane and rest ends at its deadline, the last lane
+ * pauses the workout. Every other event but FINISH catches up first, so a tap
+ * shortly after a deadline lands in the lane that deadline started, no matter
+ * whether the caller noticed the deadline before.
+ */
+uint8_t Workout_apply(WorkoutState * workout, const IntervalSchedule * schedule, WorkoutEvent event);
+
+/*
+ * Checks the state at the given time, e.g. that no more time was paused than
+ * has passed. Returns NULL if it is consistent, else the broken invariant.
+ */
+const char * Workout_checkInvariants(const WorkoutState * workout, const IntervalSchedule * schedule, WorkoutClock now);
@@ -0,0 +1,73 @@
+#include "workout_stats.h"
+
+static uint32_t isqrt(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > value) bit >>= 2;
+
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+void WorkoutStats_reset(WorkoutStats * stats, int desiredLaneCount)
+{
+    *stats = (WorkoutStats){ .desiredLaneCount = desiredLaneCount };
+}
+
+void WorkoutStats_add(WorkoutStats * stats, int lane, int laneTime)
+{
+    if (laneTime < 0)      laneTime = 0;
+    if (laneTime > 0xffff) laneTime = 0xffff;
+
+    if (stats->laneCount == 0 || laneTime < stats->bestLane)  stats->bestLane  = laneTime;
+    if (stats->laneCount == 0 || laneTime > stats->worstLane) stats->worstLane = laneTime;
+
+    ++stats->laneCount;
+    stats->sum          += laneTime;
+    stats->sumOfSquares += (uint32_t)laneTime * laneTime;
+
+    if (lane <= stats->desiredLaneCount / 2) {
+        ++stats->firstHalfCount;
+        stats->firstHalfSum += laneTime;
+    }
+}
+
+int WorkoutStats_mean(const WorkoutStats * stats)
+{
+    return stats->laneCount > 0 ? stats->sum / stats->laneCount : 0;
+}
+
+int WorkoutStats_standardDeviation(const WorkoutStats * stats)
+{
+    if (stats->laneCount < 2) return 0;
+
+    // n * sum(x^2) - sum(x)^2 never gets negative in exact integer math
+    const uint64_t n = stats->laneCount;
+    const uint64_t scaledVariance = n * stats->sumOfSquares - (uint64_t)stats->sum * stats->sum;
+    return isqrt(scaledVariance / (n * n));
+}
+
+int WorkoutStats_paceDrift(const WorkoutStats * stats)
+{
+    const int secondHalfCount = stats->laneCount - stats->firstHalfCount;
+    if (stats->firstHalfCount == 0 || secondHalfCount == 0) return 0;
+
+    const int firstHalfMean  = stats->firstHalfSum / stats->firstHalfCount;
+    const int secondHalfMean = (stats->sum - stats->firstHalfSum) / secondHalfCount;
+    return secondHalfMean - firstHalfMean;
+}
+
+int WorkoutStats_projectedRemaining(const WorkoutStats * stats)
+{
+    if (stats->laneCount >= stats->desiredLaneCount) return 0;
+    return (stats->desiredLaneCount - stats->laneCount) * WorkoutStats_mean(stats);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// Plain C without any SDK calls.
+
+#include <stdint.h>
+
+/*
+ * Running statistics of the lane times of one workout, in tenths of a
+ * second. Each lane is added in constant time and memory, nothing is stored
+ * per lane.
+ */
+typedef struct {
+    uint16_t desiredLaneCount;
+    uint16_t laneCount;
+    uint16_t firstHalfCount;
+    uint16_t bestLane;
+    uint16_t worstLane;
+    uint32_t sum;
+    uint32_t firstHalfSum;
+    uint64_t sumOfSquares;
+} WorkoutStats;
+
+void WorkoutStats_reset(WorkoutStats * stats, int desiredLaneCount);
+
+/*
+ * Adds the time of the given lane of the workout, counted from 1; its number
+ * decides the half of the desired lanes it belongs to
+ */
+void WorkoutStats_add(WorkoutStats * stats, int lane, int laneTime);
+
+int  WorkoutStats_mean(const WorkoutStats * stats);
+int  WorkoutStats_standardDeviation(const WorkoutStats * stats);
+
+/*
+ * Mean of the second half of the desired lanes minus the mean of the first
+ * half, positive if the swimmer got slower
+ */
+int  WorkoutStats_paceDrift(const WorkoutStats * stats);
+
+/*
+ * Expected time for the lanes still missing to the desired lane count
+ */
+int  WorkoutStats_projectedRemaining(const WorkoutStats * stats);
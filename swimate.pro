@@ -3,11 +3,44 @@ INCLUDEPATH += /home/choenig/.pebble-sdk/SDKs/3.10.1/sdk-core/pebble/basalt/incl
 SOURCES += \
     src/swimate.c \
     src/clock_digit.c \
+    src/history.c \
+    src/interval.c \
+    src/lane_splits.c \
     src/messagebox.c \
+    src/perf_counters.c \
+    src/persistence.c \
+    src/resource_cache.c \
+    src/sync.c \
+    src/turn_detector.c \
+    src/workout.c \
+    src/workout_stats.c \
+    worker_src/swimate_worker.c \
 
 HEADERS += \
     src/clock_digit.h \
+    src/history.h \
+    src/interval.h \
+    src/lane_splits.h \
     src/messagebox.h \
+    src/perf_counters.h \
+    src/persistence.h \
+    src/resource_cache.h \
+    src/sync.h \
+    src/turn_detector.h \
+    src/workout.h \
+    src/workout_stats.h \
 
 OTHER_FILES += \
     appinfo.json \
+    src/js/app.js \
+    src/js/export.js \
+    bench/export_bench.js \
+    bench/host/host.c \
+    bench/host/host.h \
+    bench/host/pebble.h \
+    bench/history_bench.c \
+    bench/lane_splits_bench.c \
+    bench/swimate_bench.c \
+    bench/sync_loopback.c \
+    bench/turn_detector_bench.c \
+    bench/workout_replay.c \
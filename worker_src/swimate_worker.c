@@ -0,0 +1,97 @@
+#include <pebble_worker.h>
+
+#include "../src/workout.h"
+
+// The worker owns the running workout: it applies the button events the app
+// sends, ends lanes at their deadline while the app is closed and keeps the
+// checkpoint up to date, so the app only has to read it when it is opened.
+
+static WorkoutState workout;
+static IntervalSchedule schedule;
+static bool hasWorkout = false;
+static AppTimer * deadlineTimer = NULL;
+
+static void scheduleDeadline();
+
+static WorkoutClock workoutClock()
+{
+    time_t seconds;
+    uint16_t ms;
+    WORKOUT_READ_CLOCK(&seconds, &ms);
+    return Workout_clock(&workout, seconds, ms);
+}
+
+static void writeCheckpoint()
+{
+#if WORKOUT_CHECK_INVARIANTS
+    const WorkoutClock now = workoutClock();
+    const char * broken = Workout_checkInvariants(&workout, &schedule, now);
+    if (broken) APP_LOG(APP_LOG_LEVEL_ERROR, "Worker: workout at %d ms: %s", (int)now, broken);
+#endif
+
+    persist_write_data(PERSIST_KEY_WORKOUT_CHECKPOINT, &workout, sizeof(workout));
+}
+
+static void catchUp()
+{
+    const WorkoutEvent event = { .type = WORKOUT_EVENT_CATCH_UP, .time = workoutClock() };
+    if (Workout_apply(&workout, &schedule, event) & WORKOUT_CHANGED) writeCheckpoint();
+}
+
+static void onDeadline(void * data)
+{
+    deadlineTimer = NULL;
+    catchUp();
+    scheduleDeadline();
+}
+
+static void scheduleDeadline()
+{
+    if (deadlineTimer) {
+        app_timer_cancel(deadlineTimer);
+        deadlineTimer = NULL;
+    }
+    if (!hasWorkout || Workout_isPaused(&workout)) return;
+
+    const int32_t delay = workout.virtualEndTimeOfCurrentLane - workoutClock();
+    deadlineTimer = app_timer_register(delay > 0 ? delay : 0, onDeadline, NULL);
+}
+
+static void loadCheckpoint()
+{
+    hasWorkout = persist_get_size(PERSIST_KEY_WORKOUT_CHECKPOINT) == sizeof(workout)
+              && persist_read_data(PERSIST_KEY_WORKOUT_CHECKPOINT, &workout, sizeof(workout)) == sizeof(workout);
+
+    schedule.laneCount = 0;
+    if (persist_exists(PERSIST_KEY_WORKOUT_SCHEDULE)) {
+        persist_read_data(PERSIST_KEY_WORKOUT_SCHEDULE, &schedule, sizeof(schedule));
+    }
+
+    if (hasWorkout) catchUp();
+    scheduleDeadline();
+}
+
+static void onAppMessage(uint16_t type, AppWorkerMessage * message)
+{
+    if (type == WORKOUT_MSG_RELOAD) {
+        loadCheckpoint();
+        return;
+    }
+    if (!hasWorkout) return;
+
+    const WorkoutEvent event = { .type = type, .time = (WorkoutClock)(((uint32_t)message->data1 << 16) | message->data2) };
+    if (!(Workout_apply(&workout, &schedule, event) & WORKOUT_CHANGED)) return;
+
+    writeCheckpoint();
+    scheduleDeadline();
+}
+
+int main(void)
+{
+    loadCheckpoint();
+    app_worker_message_subscribe(onAppMessage);
+
+    worker_event_loop();
+
+    app_worker_message_unsubscribe();
+}